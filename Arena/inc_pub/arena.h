@@ -0,0 +1,42 @@
+#ifndef IG_ARENA_H
+#define IG_ARENA_H
+
+#include <stdlib.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include "../../ZoneAllocatorTiny/inc_pub/zone_allocator_tiny.h"
+#include "../../ZoneAllocatorSmall/inc_pub/zone_allocator_small.h"
+#include "../../ZoneAllocatorBig/inc_pub/zone_allocator_big.h"
+
+#define ARENA_COUNT_MAX 64u // Upper bound of the number of arenas, the id has to fit the page map
+#define ARENA_REMOTE_DRAIN_THRESHOLD 64u // Remote frees pushed by a thread before it tries to drain the target arena itself
+
+typedef struct arena_remote_block arena_remote_block_t;
+
+// One independent allocator: its own tiny, small and big zones behind one lock
+typedef struct
+{
+    pthread_mutex_t lock; // Protects every zone of the arena
+    arena_remote_block_t *remote_head; // Blocks freed by threads of other arenas, waiting for a drain
+    tiny_zone_t tiny; // Tiny zone of the arena
+    small_zone_t small; // Small zone of the arena
+    big_zone_t big; // Big zone of the arena
+    uint8_t id; // Index of the arena, registered in the page map
+} arena_t;
+
+arena_t *Arena_thread_get(void);
+arena_t *Arena_get(uint8_t id);
+size_t Arena_count_get(void);
+
+void Arena_lock(arena_t *arena);
+void Arena_unlock(arena_t *arena);
+void Arena_fork_lock(void);
+void Arena_fork_unlock(void);
+
+void Arena_block_free(arena_t *arena, void *ptr, uint8_t zone);
+short Arena_remote_free(arena_t *arena, void *ptr);
+void Arena_remote_drain(arena_t *arena);
+void Arena_remote_enable_set(short enable);
+
+
+#endif // IG_ARENA_H
@@ -0,0 +1,162 @@
+#include "../inc_pub/arena.h"
+#include "../../PageMap/inc_pub/page_map.h"
+#include "../../VirtualRegion/inc_pub/virtual_region.h"
+#include <pthread.h>
+#include <unistd.h>
+
+// Threads are spread over the arenas round robin the first time they allocate.
+// There is one arena per online cpu, so threads mostly work on their own lock.
+// A block freed by a thread of another arena is pushed on the remote list of its arena
+// with a single compare and swap, the owner frees the list under its lock on its next allocation.
+
+arena_t arenas[ARENA_COUNT_MAX]; // Every arena, only the first arena_count are used
+size_t arena_count = 0u; // Number of arenas in use
+size_t arena_next = 0u; // Next arena handed to a new thread
+pthread_once_t arena_once = PTHREAD_ONCE_INIT;
+__thread arena_t *arena_thread = NULL; // Arena of the calling thread
+__thread size_t arena_remote_pushes = 0u; // Remote frees pushed by the calling thread since its last drain attempt
+short arena_remote_enabled = 1; // Remote frees go through the remote lists, otherwise they lock the owning arena
+
+struct arena_remote_block
+{
+    arena_remote_block_t *next; // Next block of the remote list
+};
+
+static void arenas_init(void)
+{
+    long cpu_count = sysconf(_SC_NPROCESSORS_ONLN); // Get the number of cpus
+
+    arena_count = (cpu_count < 1) ? (1u) : ((size_t)cpu_count);
+    arena_count = (arena_count > ARENA_COUNT_MAX) ? (ARENA_COUNT_MAX) : (arena_count);
+    for (size_t i = 0u; i < arena_count; i++)
+    {
+        pthread_mutex_init(&arenas[i].lock, NULL);
+        arenas[i].id = (uint8_t)i;
+        arenas[i].tiny.arena_id = (uint8_t)i;
+        arenas[i].small.arena_id = (uint8_t)i;
+        arenas[i].big.arena_id = (uint8_t)i;
+    }
+}
+
+// Returns the arena of the calling thread, assigning one on the first call.
+arena_t *Arena_thread_get(void)
+{
+    if (arena_thread == NULL)
+    {
+        pthread_once(&arena_once, arenas_init);
+        arena_thread = &arenas[__atomic_fetch_add(&arena_next, 1u, __ATOMIC_RELAXED) % arena_count];
+    }
+    return (arena_thread);
+}
+
+// Returns the arena with the given id, the id comes from the page map.
+arena_t *Arena_get(uint8_t id)
+{
+    return (&arenas[id]);
+}
+
+// Returns the number of arenas in use.
+size_t Arena_count_get(void)
+{
+    pthread_once(&arena_once, arenas_init);
+    return (arena_count);
+}
+
+void Arena_lock(arena_t *arena)
+{
+    pthread_mutex_lock(&arena->lock);
+}
+
+void Arena_unlock(arena_t *arena)
+{
+    pthread_mutex_unlock(&arena->lock);
+}
+
+// Takes the lock of every arena so a fork cannot copy one held, Arena_fork_unlock releases them in both processes.
+void Arena_fork_lock(void)
+{
+    for (size_t i = 0u; i < Arena_count_get(); i++)
+    {
+        pthread_mutex_lock(&arenas[i].lock);
+    }
+}
+
+void Arena_fork_unlock(void)
+{
+    for (size_t i = 0u; i < arena_count; i++)
+    {
+        pthread_mutex_unlock(&arenas[i].lock);
+    }
+}
+
+// Frees a block of the given zone, the arena lock must be held.
+void Arena_block_free(arena_t *arena, void *ptr, uint8_t zone)
+{
+    switch (zone)
+    {
+        case PAGE_MAP_ZONE_TINY:
+            ZoneAllocatorTiny_free(&arena->tiny, ptr);
+            break;
+        case PAGE_MAP_ZONE_SMALL:
+            ZoneAllocatorSmall_free(&arena->small, ptr);
+            break;
+        case PAGE_MAP_ZONE_BIG:
+            ZoneAllocatorBig_free(&arena->big, ptr);
+            break;
+        default:
+            break;
+    }
+}
+
+// Pushes a block owned by another arena on the remote list of that arena.
+// Every ARENA_REMOTE_DRAIN_THRESHOLD pushes the thread drains the arena itself if its lock is free,
+// so the blocks do not pile up when the owner stops allocating.
+// Returns 0 if the block was pushed, -1 if the caller has to free it under the arena lock.
+short Arena_remote_free(arena_t *arena, void *ptr)
+{
+    arena_remote_block_t *block = ptr;
+    arena_remote_block_t *head;
+
+    if ((__atomic_load_n(&arena_remote_enabled, __ATOMIC_RELAXED) == 0) || (arena == Arena_thread_get()))
+    {
+        return (-1);
+    }
+    head = __atomic_load_n(&arena->remote_head, __ATOMIC_RELAXED);
+    do
+    {
+        block->next = head;
+    } while (__atomic_compare_exchange_n(&arena->remote_head, &head, block, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED) == 0);
+    arena_remote_pushes++;
+    if ((arena_remote_pushes >= ARENA_REMOTE_DRAIN_THRESHOLD) && (pthread_mutex_trylock(&arena->lock) == 0))
+    {
+        arena_remote_pushes = 0u;
+        Arena_remote_drain(arena);
+        Arena_unlock(arena);
+    }
+    return (0);
+}
+
+// Frees every block of the remote list of the arena, the arena lock must be held.
+void Arena_remote_drain(arena_t *arena)
+{
+    arena_remote_block_t *block;
+    arena_remote_block_t *next;
+
+    if (__atomic_load_n(&arena->remote_head, __ATOMIC_RELAXED) == NULL)
+    {
+        return; // Nothing to drain, skip the atomic exchange
+    }
+    block = __atomic_exchange_n(&arena->remote_head, NULL, __ATOMIC_ACQUIRE);
+    while (block != NULL)
+    {
+        next = block->next;
+        Arena_block_free(arena, block, VirtualRegion_zone_get(block));
+        block = next;
+    }
+}
+
+// Enables or disables the remote lists. Blocks already pushed are drained as usual.
+void Arena_remote_enable_set(short enable)
+{
+    __atomic_store_n(&arena_remote_enabled, (enable != 0) ? (1) : (0), __ATOMIC_RELAXED);
+}
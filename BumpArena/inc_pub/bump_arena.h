@@ -0,0 +1,33 @@
+#ifndef IG_BUMP_ARENA_H
+#define IG_BUMP_ARENA_H
+
+#include <stdlib.h>
+#include <inttypes.h>
+
+#define BUMP_ARENA_CHUNK_SIZE ((size_t)64u << 10u) // Default size of a chunk
+#define BUMP_ARENA_CHUNK_SIZE_MIN 4096u // Smallest chunk, it holds the arena header in the first one
+#define BUMP_ARENA_ALIGNMENT 16u // Alignment of every bump allocation
+
+typedef struct bump_chunk bump_chunk_t;
+
+// Bump allocator over chunks taken from the big zone of an arena. It lives in its first chunk.
+// One thread uses a bump arena at a time, only the chunk allocations and frees lock the arena.
+typedef struct
+{
+    bump_chunk_t *first; // Chunk holding this header, kept until the arena is destroyed
+    bump_chunk_t *current; // Chunk being bumped, head of the list of the chunks in use
+    bump_chunk_t *spare; // Chunks kept by a reset for reuse
+    uint8_t *top; // Next free byte of the current chunk
+    uint8_t *end; // End of the current chunk
+    size_t chunk_size; // Size of a new chunk, a larger request gets a chunk of its own size
+    short keep; // 1 if a reset keeps the chunks for reuse, 0 if it frees them
+    uint8_t arena_id; // Arena whose big zone holds the chunks
+} bump_arena_t;
+
+bump_arena_t *BumpArena_create(size_t chunk_size, short keep);
+void *BumpArena_alloc(bump_arena_t *bump, size_t size);
+void BumpArena_reset(bump_arena_t *bump);
+void BumpArena_destroy(bump_arena_t *bump);
+
+
+#endif // IG_BUMP_ARENA_H
@@ -0,0 +1,214 @@
+#include "../inc_pub/bump_arena.h"
+#include "../../Arena/inc_pub/arena.h"
+#include "../../ZoneAllocatorBig/inc_pub/zone_allocator_big.h"
+#include <stddef.h>
+#include <inttypes.h>
+
+// A chunk is one allocated block of the big zone, so it shows up in the big zone report.
+// An allocation only moves the top of the current chunk and takes no lock, so the used size of
+// the blocks, read by the report under the arena lock, is only written under that lock, once per chunk:
+// the current chunk uses all of its room, a chunk left behind the bytes bumped out of it, a spare its header.
+// A reset puts the top back at the start of the first chunk and frees or keeps the other chunks,
+// one step per chunk, whatever was allocated from them.
+
+// Header of a chunk, at the start of its big block
+struct bump_chunk
+{
+    bump_chunk_t *next; // Next chunk of the same list
+    size_t size; // Payload size of the big block, the chunk ends there
+};
+
+#define BUMP_ALIGN(size) ((((size) + BUMP_ARENA_ALIGNMENT - 1u) / BUMP_ARENA_ALIGNMENT) * BUMP_ARENA_ALIGNMENT) // Round up to the bump alignment
+#define BUMP_CHUNK_HEADER_SIZE BUMP_ALIGN(sizeof(bump_chunk_t)) // Chunk header, keeps the allocations aligned
+#define BUMP_ARENA_HEADER_SIZE BUMP_ALIGN(sizeof(bump_arena_t)) // Arena header, right after the header of the first chunk
+#define BUMP_CHUNK_START(chunk) ((uint8_t *)(chunk) + BUMP_CHUNK_HEADER_SIZE) // First byte bumped out of a chunk
+#define BUMP_CHUNK_END(chunk) ((uint8_t *)(chunk) + (chunk)->size) // End of a chunk
+#define BUMP_SIZE_MAX (SIZE_MAX / 2u) // Largest request, keeps the size computations from overflowing
+
+// Takes a chunk of at least size bytes from the big zone of the arena, it uses all of its room.
+static bump_chunk_t *chunk_new(uint8_t arena_id, size_t size)
+{
+    arena_t *arena = Arena_get(arena_id);
+    bump_chunk_t *chunk;
+
+    Arena_lock(arena);
+    Arena_remote_drain(arena);
+    chunk = ZoneAllocatorBig_alloc(&arena->big, size);
+    if (chunk != NULL)
+    {
+        chunk->next = NULL;
+        chunk->size = ZoneAllocatorBig_capacity_get(chunk); // Bump up to the end of the block
+        ZoneAllocatorBig_used_set(chunk, chunk->size);
+    }
+    Arena_unlock(arena);
+    return (chunk);
+}
+
+// Gives a list of chunks back to the big zone of the arena, under one lock.
+static void chunks_free(uint8_t arena_id, bump_chunk_t *chunk)
+{
+    arena_t *arena = Arena_get(arena_id);
+    bump_chunk_t *next;
+
+    if (chunk == NULL)
+    {
+        return;
+    }
+    Arena_lock(arena);
+    while (chunk != NULL)
+    {
+        next = chunk->next;
+        ZoneAllocatorBig_free(&arena->big, chunk);
+        chunk = next;
+    }
+    Arena_unlock(arena);
+}
+
+// Takes the first spare chunk of at least size bytes, NULL if none.
+static bump_chunk_t *spare_take(bump_arena_t *bump, size_t size)
+{
+    bump_chunk_t **link = &bump->spare;
+
+    while ((*link != NULL) && ((*link)->size < size))
+    {
+        link = &(*link)->next;
+    }
+    if (*link == NULL)
+    {
+        return (NULL);
+    }
+    bump_chunk_t *chunk = *link;
+    *link = chunk->next;
+    chunk->next = NULL;
+    return (chunk);
+}
+
+// Allocates size bytes, already aligned, that do not fit the current chunk.
+// The new chunk becomes the current one, unless it is left with less room than the current one:
+// a request larger than a chunk gets a chunk of its own, linked after the current one.
+static void *chunk_alloc(bump_arena_t *bump, size_t size)
+{
+    arena_t *arena = Arena_get(bump->arena_id);
+    bump_chunk_t *chunk;
+    size_t need = BUMP_CHUNK_HEADER_SIZE + size;
+
+    chunk = spare_take(bump, need);
+    if (chunk == NULL)
+    {
+        chunk = chunk_new(bump->arena_id, (need > bump->chunk_size) ? (need) : (bump->chunk_size));
+        if (chunk == NULL)
+        {
+            return (NULL);
+        }
+    }
+    Arena_lock(arena);
+    if (chunk->size - need < (size_t)(bump->end - bump->top))
+    {
+        ZoneAllocatorBig_used_set(chunk, need); // Holds this request only
+        Arena_unlock(arena);
+        chunk->next = bump->current->next; // Kept behind the current chunk, until the next reset
+        bump->current->next = chunk;
+        return (BUMP_CHUNK_START(chunk));
+    }
+    ZoneAllocatorBig_used_set(bump->current, (size_t)(bump->top - (uint8_t *)bump->current)); // Left behind, no more bytes are bumped out of it
+    ZoneAllocatorBig_used_set(chunk, chunk->size);
+    Arena_unlock(arena);
+    chunk->next = bump->current;
+    bump->current = chunk;
+    bump->top = BUMP_CHUNK_START(chunk) + size;
+    bump->end = BUMP_CHUNK_END(chunk);
+    return (BUMP_CHUNK_START(chunk));
+}
+
+// Creates a bump arena whose chunks are chunk_size bytes, 0 for BUMP_ARENA_CHUNK_SIZE, taken from the arena of the calling thread.
+// If keep is set a reset keeps the chunks for reuse, otherwise it gives them back to the big zone.
+// Returns NULL if the first chunk could not be allocated.
+bump_arena_t *BumpArena_create(size_t chunk_size, short keep)
+{
+    bump_arena_t *bump;
+    bump_chunk_t *first;
+    uint8_t arena_id = Arena_thread_get()->id;
+
+    chunk_size = (chunk_size == 0u) ? (BUMP_ARENA_CHUNK_SIZE) : (chunk_size);
+    if (chunk_size > BUMP_SIZE_MAX)
+    {
+        return (NULL); // Invalid size
+    }
+    chunk_size = (chunk_size < BUMP_ARENA_CHUNK_SIZE_MIN) ? (BUMP_ARENA_CHUNK_SIZE_MIN) : (BUMP_ALIGN(chunk_size));
+    first = chunk_new(arena_id, chunk_size);
+    if (first == NULL)
+    {
+        return (NULL); // Allocation failed
+    }
+    bump = (bump_arena_t *)BUMP_CHUNK_START(first);
+    bump->first = first;
+    bump->current = first;
+    bump->spare = NULL;
+    bump->top = BUMP_CHUNK_START(first) + BUMP_ARENA_HEADER_SIZE;
+    bump->end = BUMP_CHUNK_END(first);
+    bump->chunk_size = chunk_size;
+    bump->keep = (keep != 0) ? (1) : (0);
+    bump->arena_id = arena_id;
+    return (bump);
+}
+
+// Allocates size bytes aligned to BUMP_ARENA_ALIGNMENT, they stay allocated until the next reset or the destroy.
+// Returns NULL if size is 0 or no chunk could be allocated.
+void *BumpArena_alloc(bump_arena_t *bump, size_t size)
+{
+    uint8_t *ptr = bump->top;
+
+    if ((size == 0u) || (size > BUMP_SIZE_MAX))
+    {
+        return (NULL); // Invalid size
+    }
+    size = BUMP_ALIGN(size);
+    if (size > (size_t)(bump->end - ptr))
+    {
+        return (chunk_alloc(bump, size));
+    }
+    bump->top = ptr + size;
+    return ((void *)ptr);
+}
+
+// Makes every allocation of the arena free again, in one step per chunk under one lock of the arena.
+// The first chunk is bumped again from its start, the others are kept as spares or freed.
+void BumpArena_reset(bump_arena_t *bump)
+{
+    arena_t *arena = Arena_get(bump->arena_id);
+    bump_chunk_t *chunk = bump->current;
+    bump_chunk_t *next;
+
+    Arena_lock(arena);
+    while (chunk != NULL)
+    {
+        next = chunk->next;
+        if ((chunk != bump->first) && (bump->keep != 0))
+        {
+            ZoneAllocatorBig_used_set(chunk, BUMP_CHUNK_HEADER_SIZE); // Only the chunk header is live
+            chunk->next = bump->spare;
+            bump->spare = chunk;
+        }
+        else if (chunk != bump->first)
+        {
+            ZoneAllocatorBig_free(&arena->big, chunk);
+        }
+        chunk = next;
+    }
+    ZoneAllocatorBig_used_set(bump->first, bump->first->size); // Current chunk again
+    Arena_unlock(arena);
+    bump->first->next = NULL;
+    bump->current = bump->first;
+    bump->top = BUMP_CHUNK_START(bump->first) + BUMP_ARENA_HEADER_SIZE;
+    bump->end = BUMP_CHUNK_END(bump->first);
+}
+
+// Gives every chunk back to the big zone, the arena header goes with the first one.
+void BumpArena_destroy(bump_arena_t *bump)
+{
+    uint8_t arena_id = bump->arena_id;
+    bump_chunk_t *current = bump->current;
+
+    chunks_free(arena_id, bump->spare);
+    chunks_free(arena_id, current); // Holds the first chunk
+}
@@ -0,0 +1,27 @@
+#ifndef IG_MAP_CACHE_H
+#define IG_MAP_CACHE_H
+
+#include <stdlib.h>
+#include <inttypes.h>
+
+#define MAP_CACHE_BUDGET_DEFAULT (size_t)(32u * 1024u * 1024u) // Bytes of empty mappings kept by default
+#define MAP_CACHE_DECAY_MS_DEFAULT 10000u // Time an empty mapping is kept by default, in milliseconds
+#define MAP_CACHE_HUGE_PAGE_SIZE (size_t)(2u * 1024u * 1024u) // Size and alignment of a huge page mapping
+
+void *MapCache_map(uint8_t zone, size_t size, short huge, short *zeroed);
+void MapCache_unmap(void *map, size_t size, short huge);
+void MapCache_unmap_now(void *map, size_t size);
+
+size_t MapCache_release(void);
+size_t MapCache_purge(void);
+size_t MapCache_trim(size_t pad);
+size_t MapCache_retained_get(void);
+void MapCache_budget_set(size_t budget);
+void MapCache_decay_set(size_t decay_ms);
+short MapCache_huge_get(void);
+void MapCache_huge_set(short enable);
+void MapCache_fork_lock(void);
+void MapCache_fork_unlock(void);
+
+
+#endif // IG_MAP_CACHE_H
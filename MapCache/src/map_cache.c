@@ -0,0 +1,350 @@
+#define _GNU_SOURCE // MAP_HUGETLB
+#include "../inc_pub/map_cache.h"
+#include "../../VirtualRegion/inc_pub/virtual_region.h"
+#include "../../PageMap/inc_pub/page_map.h"
+#include <sys/mman.h>
+#include <pthread.h>
+#include <inttypes.h>
+#include <time.h>
+
+// Cache of empty zone mappings shared by every zone of every arena.
+// A zone that gives a mapping back hands it to the cache instead of munmap, the next zone
+// that needs a mapping of the same size gets it back without a syscall and with its pages still faulted in.
+// Mappings are kept while they fit the byte budget and are younger than the decay period,
+// the oldest ones are unmapped first. If mmap fails every kept mapping is released and mmap is tried again.
+// Huge mappings are sized and aligned to 2 MB and backed by huge pages: MAP_HUGETLB if the system has some reserved,
+// transparent huge pages otherwise. They are only reused by requests for a huge mapping.
+// New mappings are taken from the range of their zone kind in the virtual region when it has room.
+
+#define MAP_CACHE_PAGE_SIZE 4096u // Granularity of the buckets
+#define MAP_CACHE_BUCKET_COUNT 128u // Buckets by page count, the last one holds every larger mapping
+
+typedef struct map_cache_entry map_cache_entry_t;
+
+// Header written at the start of a kept mapping
+struct map_cache_entry
+{
+    map_cache_entry_t *next; // Next older mapping
+    map_cache_entry_t *prev; // Previous younger mapping
+    map_cache_entry_t *bucket_next; // Next mapping of the same bucket
+    map_cache_entry_t *bucket_prev; // Previous mapping of the same bucket
+    size_t size; // Size of the mapping
+    uint64_t release_ns; // Time the mapping was given back
+    short huge; // 1 if the mapping is made of huge pages
+    uint8_t zone; // Range of the virtual region holding the mapping, PAGE_MAP_ZONE_NONE outside of it
+};
+
+map_cache_entry_t *map_cache_young = NULL; // Youngest kept mapping
+map_cache_entry_t *map_cache_old = NULL; // Oldest kept mapping
+map_cache_entry_t *map_cache_buckets[MAP_CACHE_BUCKET_COUNT]; // Kept mappings by page count, youngest first
+size_t map_cache_retained = 0u; // Bytes of kept mappings
+size_t map_cache_budget = MAP_CACHE_BUDGET_DEFAULT; // Upper bound of map_cache_retained
+uint64_t map_cache_decay_ns = (uint64_t)MAP_CACHE_DECAY_MS_DEFAULT * 1000000u; // Time a mapping is kept
+short map_cache_huge = 0; // 1 if the zones ask for huge mappings
+pthread_mutex_t map_cache_lock = PTHREAD_MUTEX_INITIALIZER; // Protects the lists and the counters
+
+static uint64_t time_get(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (((uint64_t)ts.tv_sec * 1000000000u) + (uint64_t)ts.tv_nsec);
+}
+
+// Gives a mapping back to the system, to the virtual region if it comes from it.
+static void map_release(void *map, size_t size)
+{
+    if (VirtualRegion_unmap(map, size) != 0)
+    {
+        munmap(map, size);
+    }
+}
+
+static size_t bucket_get(size_t size)
+{
+    size_t pages = size / MAP_CACHE_PAGE_SIZE;
+
+    return ((pages < MAP_CACHE_BUCKET_COUNT) ? (pages) : (MAP_CACHE_BUCKET_COUNT - 1u));
+}
+
+static void entry_add(map_cache_entry_t *entry)
+{
+    size_t bucket = bucket_get(entry->size);
+
+    entry->prev = NULL;
+    entry->next = map_cache_young;
+    if (map_cache_young == NULL)
+    {
+        map_cache_old = entry;
+    }
+    else
+    {
+        map_cache_young->prev = entry;
+    }
+    map_cache_young = entry;
+    entry->bucket_prev = NULL;
+    entry->bucket_next = map_cache_buckets[bucket];
+    if (entry->bucket_next != NULL)
+    {
+        entry->bucket_next->bucket_prev = entry;
+    }
+    map_cache_buckets[bucket] = entry;
+    map_cache_retained += entry->size;
+}
+
+static void entry_remove(map_cache_entry_t *entry)
+{
+    if (entry->prev == NULL)
+    {
+        map_cache_young = entry->next;
+    }
+    else
+    {
+        entry->prev->next = entry->next;
+    }
+    if (entry->next == NULL)
+    {
+        map_cache_old = entry->prev;
+    }
+    else
+    {
+        entry->next->prev = entry->prev;
+    }
+    if (entry->bucket_prev == NULL)
+    {
+        map_cache_buckets[bucket_get(entry->size)] = entry->bucket_next;
+    }
+    else
+    {
+        entry->bucket_prev->bucket_next = entry->bucket_next;
+    }
+    if (entry->bucket_next != NULL)
+    {
+        entry->bucket_next->bucket_prev = entry->bucket_prev;
+    }
+    map_cache_retained -= entry->size;
+}
+
+// Unmaps the oldest mappings while they are past the decay period or the budget is exceeded.
+// Returns the number of bytes given back to the system.
+static size_t cache_decay(uint64_t now)
+{
+    map_cache_entry_t *entry;
+    size_t released = 0u;
+
+    while ((map_cache_old != NULL)
+        && ((map_cache_retained > map_cache_budget) || (now - map_cache_old->release_ns >= map_cache_decay_ns)))
+    {
+        entry = map_cache_old;
+        entry_remove(entry);
+        released += entry->size;
+        map_release((void *)entry, entry->size);
+    }
+    return (released);
+}
+
+// Maps size bytes, a multiple of MAP_CACHE_HUGE_PAGE_SIZE aligned to it if huge is 1.
+// Huge pages come from MAP_HUGETLB when the system has some reserved, otherwise the mapping is advised
+// to use transparent huge pages. In the region the huge page mapping replaces the aligned slice handed out,
+// a release puts the PROT_NONE reservation back over it. Out of the region the mapping is
+// over allocated to cut an aligned range out of it.
+static void *map_new(uint8_t zone, size_t size, short huge)
+{
+    uint8_t *map;
+    size_t head;
+
+    map = VirtualRegion_map(zone, size, (huge != 0) ? (MAP_CACHE_HUGE_PAGE_SIZE) : (0u));
+    if ((map != NULL) && (huge != 0))
+    {
+        if (mmap((void *)map, size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE | MAP_FIXED | MAP_HUGETLB, -1, 0) != MAP_FAILED)
+        {
+            return ((void *)map);
+        }
+        if (mmap((void *)map, size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE | MAP_FIXED, -1, 0) == MAP_FAILED)
+        {
+            VirtualRegion_unmap((void *)map, size); // The failed MAP_FIXED may have dropped the slice
+            return (NULL);
+        }
+        madvise((void *)map, size, MADV_HUGEPAGE); // Best effort, the mapping is usable either way
+    }
+    if (map != NULL)
+    {
+        return ((void *)map);
+    }
+    if (huge == 0)
+    {
+        map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+        return ((map == MAP_FAILED) ? (NULL) : ((void *)map));
+    }
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE | MAP_HUGETLB, -1, 0);
+    if (map != MAP_FAILED)
+    {
+        return ((void *)map); // Huge page mappings are aligned to the huge page size
+    }
+    map = mmap(NULL, size + MAP_CACHE_HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (map == MAP_FAILED)
+    {
+        return (NULL);
+    }
+    head = (MAP_CACHE_HUGE_PAGE_SIZE - ((uintptr_t)map % MAP_CACHE_HUGE_PAGE_SIZE)) % MAP_CACHE_HUGE_PAGE_SIZE;
+    if (head != 0u)
+    {
+        munmap((void *)map, head);
+    }
+    munmap((void *)(map + head + size), MAP_CACHE_HUGE_PAGE_SIZE - head);
+    madvise((void *)(map + head), size, MADV_HUGEPAGE); // Best effort, the mapping is usable either way
+    return ((void *)(map + head));
+}
+
+// Returns a mapping of size bytes for a zone of the given kind, a kept one of the same size and kind if any,
+// NULL if the system is out of memory.
+// With huge set to 1 the size has to be a multiple of MAP_CACHE_HUGE_PAGE_SIZE.
+// A kept mapping is not zeroed, the zone has to initialise every header it relies on.
+// If zeroed is not NULL it is set to 1 for a new mapping, whose pages all read as zero, 0 for a kept one.
+void *MapCache_map(uint8_t zone, size_t size, short huge, short *zeroed)
+{
+    map_cache_entry_t *entry;
+    void *map;
+
+    pthread_mutex_lock(&map_cache_lock);
+    cache_decay(time_get());
+    entry = map_cache_buckets[bucket_get(size)];
+    while ((entry != NULL) && ((entry->size != size) || (entry->huge != huge)
+        || ((entry->zone != zone) && (entry->zone != PAGE_MAP_ZONE_NONE))))
+    {
+        entry = entry->bucket_next;
+    }
+    if (entry != NULL)
+    {
+        entry_remove(entry);
+    }
+    pthread_mutex_unlock(&map_cache_lock);
+    if (zeroed != NULL)
+    {
+        *zeroed = (entry == NULL) ? (1) : (0);
+    }
+    if (entry != NULL)
+    {
+        return ((void *)entry);
+    }
+    map = map_new(zone, size, huge);
+    if ((map == NULL) && (MapCache_release() != 0u))
+    {
+        map = map_new(zone, size, huge); // Memory pressure, try again with the cache empty
+    }
+    return (map);
+}
+
+// Takes back an empty zone mapping, it is kept for reuse if the budget allows it.
+// huge tells whether it was mapped with huge set to 1.
+void MapCache_unmap(void *map, size_t size, short huge)
+{
+    map_cache_entry_t *entry = map;
+    uint64_t now = time_get();
+
+    pthread_mutex_lock(&map_cache_lock);
+    if (size > map_cache_budget)
+    {
+        pthread_mutex_unlock(&map_cache_lock);
+        map_release(map, size);
+        return;
+    }
+    entry->size = size;
+    entry->release_ns = now;
+    entry->huge = huge;
+    entry->zone = VirtualRegion_range_get(map);
+    entry_add(entry);
+    cache_decay(now);
+    pthread_mutex_unlock(&map_cache_lock);
+}
+
+// Unmaps every kept mapping.
+// Returns the number of bytes given back to the system.
+size_t MapCache_release(void)
+{
+    return (MapCache_trim(0u));
+}
+
+// Unmaps the oldest kept mappings until at most pad bytes are left.
+// Returns the number of bytes given back to the system.
+size_t MapCache_trim(size_t pad)
+{
+    map_cache_entry_t *entry;
+    size_t released = 0u;
+
+    pthread_mutex_lock(&map_cache_lock);
+    while ((map_cache_old != NULL) && (map_cache_retained > pad))
+    {
+        entry = map_cache_old;
+        entry_remove(entry);
+        released += entry->size;
+        map_release((void *)entry, entry->size);
+    }
+    pthread_mutex_unlock(&map_cache_lock);
+    return (released);
+}
+
+// Unmaps the kept mappings past the decay period, mappings are otherwise only aged when a zone maps or unmaps.
+// Returns the number of bytes given back to the system.
+size_t MapCache_purge(void)
+{
+    size_t released;
+
+    pthread_mutex_lock(&map_cache_lock);
+    released = cache_decay(time_get());
+    pthread_mutex_unlock(&map_cache_lock);
+    return (released);
+}
+
+// Returns the number of bytes of empty mappings kept for reuse.
+size_t MapCache_retained_get(void)
+{
+    return (__atomic_load_n(&map_cache_retained, __ATOMIC_RELAXED));
+}
+
+// Sets the number of bytes of empty mappings kept for reuse, 0 disables the cache.
+void MapCache_budget_set(size_t budget)
+{
+    pthread_mutex_lock(&map_cache_lock);
+    map_cache_budget = budget;
+    cache_decay(time_get());
+    pthread_mutex_unlock(&map_cache_lock);
+}
+
+// Sets the time an empty mapping is kept before it is unmapped.
+void MapCache_decay_set(size_t decay_ms)
+{
+    pthread_mutex_lock(&map_cache_lock);
+    map_cache_decay_ns = (uint64_t)decay_ms * 1000000u;
+    cache_decay(time_get());
+    pthread_mutex_unlock(&map_cache_lock);
+}
+
+// Gives an empty zone mapping back to the system right away, without keeping it.
+void MapCache_unmap_now(void *map, size_t size)
+{
+    map_release(map, size);
+}
+
+// Takes the cache lock so a fork cannot copy it held, MapCache_fork_unlock releases it in both processes.
+void MapCache_fork_lock(void)
+{
+    pthread_mutex_lock(&map_cache_lock);
+}
+
+void MapCache_fork_unlock(void)
+{
+    pthread_mutex_unlock(&map_cache_lock);
+}
+
+// Returns 1 if the zones ask for huge mappings.
+short MapCache_huge_get(void)
+{
+    return (__atomic_load_n(&map_cache_huge, __ATOMIC_RELAXED));
+}
+
+// Makes the zones ask for huge mappings from now on (1) or not (0), mappings already made keep their pages.
+void MapCache_huge_set(short enable)
+{
+    __atomic_store_n(&map_cache_huge, enable, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,20 @@
+#ifndef IG_PAGE_MAP_H
+#define IG_PAGE_MAP_H
+
+#include <stdlib.h>
+#include <inttypes.h>
+
+#define PAGE_MAP_ZONE_NONE 0u // Page is not owned by any zone
+#define PAGE_MAP_ZONE_TINY 1u // Page belongs to the tiny zone
+#define PAGE_MAP_ZONE_SMALL 2u // Page belongs to the small zone
+#define PAGE_MAP_ZONE_BIG 3u // Page belongs to a big zone map
+
+short PageMap_register(void *start, size_t size, uint8_t zone, uint8_t arena, void *owner);
+void PageMap_unregister(void *start, size_t size);
+
+uint8_t PageMap_zone_get(void *ptr);
+uint8_t PageMap_arena_get(void *ptr);
+void *PageMap_owner_get(void *ptr, uint8_t zone);
+
+
+#endif // IG_PAGE_MAP_H
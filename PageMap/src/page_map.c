@@ -0,0 +1,167 @@
+#include "../inc_pub/page_map.h"
+#include <sys/mman.h>
+#include <inttypes.h>
+
+// Two level radix map from page number to the zone that owns the page.
+// Every entry holds the owner pointer (page aligned header of the zone or map)
+// with the zone id and the arena id packed in the low bits, so a lookup is two loads.
+// Lookups take no lock: leaves are installed with a compare and swap and never removed,
+// entries are written by the arena that maps the range before any pointer into it is returned.
+
+#define PAGE_MAP_PAGE_SHIFT 12u // Granularity of the map (4 KB pages)
+#define PAGE_MAP_ADDRESS_BITS 47u // Usable bits of a user space address
+#define PAGE_MAP_LEAF_BITS 18u // Pages covered by one leaf (1 GB of address space)
+#define PAGE_MAP_ROOT_BITS (PAGE_MAP_ADDRESS_BITS - PAGE_MAP_PAGE_SHIFT - PAGE_MAP_LEAF_BITS)
+#define PAGE_MAP_LEAF_COUNT ((size_t)1u << PAGE_MAP_LEAF_BITS) // Entries in one leaf
+#define PAGE_MAP_ROOT_COUNT ((size_t)1u << PAGE_MAP_ROOT_BITS) // Leaves in the root
+#define PAGE_MAP_ZONE_MASK (uintptr_t)0xFu // Bits of the entry used by the zone id
+#define PAGE_MAP_ARENA_SHIFT 4u // First bit of the arena id
+#define PAGE_MAP_ARENA_MASK (uintptr_t)0xFF0u // Bits of the entry used by the arena id
+#define PAGE_MAP_OWNER_MASK (~(uintptr_t)0xFFFu) // Bits of the entry used by the owner
+
+uintptr_t **page_map_root = NULL; // Root of the page map, mapped on first registration
+
+// Maps zeroed memory for the page map itself.
+static void *table_map(size_t size)
+{
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+
+    return ((map == MAP_FAILED) ? (NULL) : (map));
+}
+
+// Returns the leaf that covers the page, creating it when requested.
+// Concurrent creators race with a compare and swap, the loser unmaps its copy.
+static uintptr_t *leaf_get(size_t page, short create)
+{
+    size_t root_index = page >> PAGE_MAP_LEAF_BITS;
+    uintptr_t **root = __atomic_load_n(&page_map_root, __ATOMIC_ACQUIRE);
+    uintptr_t *leaf;
+    void *expected;
+
+    if (root_index >= PAGE_MAP_ROOT_COUNT)
+    {
+        return (NULL); // Address out of range
+    }
+    if (root == NULL)
+    {
+        if (create == 0)
+        {
+            return (NULL);
+        }
+        root = table_map(PAGE_MAP_ROOT_COUNT * sizeof(uintptr_t *));
+        if (root == NULL)
+        {
+            return (NULL);
+        }
+        expected = NULL;
+        if (__atomic_compare_exchange_n(&page_map_root, &expected, root, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) == 0)
+        {
+            munmap((void *)root, PAGE_MAP_ROOT_COUNT * sizeof(uintptr_t *));
+            root = expected; // Installed by another thread
+        }
+    }
+    leaf = __atomic_load_n(&root[root_index], __ATOMIC_ACQUIRE);
+    if (leaf == NULL)
+    {
+        if (create == 0)
+        {
+            return (NULL);
+        }
+        leaf = table_map(PAGE_MAP_LEAF_COUNT * sizeof(uintptr_t));
+        if (leaf == NULL)
+        {
+            return (NULL);
+        }
+        expected = NULL;
+        if (__atomic_compare_exchange_n(&root[root_index], &expected, leaf, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) == 0)
+        {
+            munmap((void *)leaf, PAGE_MAP_LEAF_COUNT * sizeof(uintptr_t));
+            leaf = expected; // Installed by another thread
+        }
+    }
+    return (leaf);
+}
+
+// Returns the entry of the page of ptr, 0 if the page is not registered.
+static uintptr_t entry_get(void *ptr)
+{
+    size_t page = (uintptr_t)ptr >> PAGE_MAP_PAGE_SHIFT;
+    uintptr_t *leaf = leaf_get(page, 0);
+
+    if (leaf == NULL)
+    {
+        return (0u);
+    }
+    return (__atomic_load_n(&leaf[page & (PAGE_MAP_LEAF_COUNT - 1u)], __ATOMIC_RELAXED));
+}
+
+// Marks every page of the range as owned by the given zone, arena and owner.
+// The owner must be page aligned.
+// Returns 0 on success, -1 if the page map could not be extended.
+short PageMap_register(void *start, size_t size, uint8_t zone, uint8_t arena, void *owner)
+{
+    size_t page = (uintptr_t)start >> PAGE_MAP_PAGE_SHIFT;
+    size_t last_page = ((uintptr_t)start + size - 1u) >> PAGE_MAP_PAGE_SHIFT;
+    uintptr_t entry = (uintptr_t)owner | ((uintptr_t)arena << PAGE_MAP_ARENA_SHIFT) | (uintptr_t)zone;
+    uintptr_t *leaf;
+
+    while (page <= last_page)
+    {
+        leaf = leaf_get(page, 1);
+        if (leaf == NULL)
+        {
+            PageMap_unregister(start, (page << PAGE_MAP_PAGE_SHIFT) - (uintptr_t)start);
+            return (-1);
+        }
+        __atomic_store_n(&leaf[page & (PAGE_MAP_LEAF_COUNT - 1u)], entry, __ATOMIC_RELEASE);
+        page++;
+    }
+    return (0);
+}
+
+// Clears the ownership of every page of the range.
+void PageMap_unregister(void *start, size_t size)
+{
+    size_t page = (uintptr_t)start >> PAGE_MAP_PAGE_SHIFT;
+    size_t last_page = ((uintptr_t)start + size - 1u) >> PAGE_MAP_PAGE_SHIFT;
+    uintptr_t *leaf;
+
+    if (size == 0u)
+    {
+        return;
+    }
+    while (page <= last_page)
+    {
+        leaf = leaf_get(page, 0);
+        if (leaf != NULL)
+        {
+            __atomic_store_n(&leaf[page & (PAGE_MAP_LEAF_COUNT - 1u)], 0u, __ATOMIC_RELEASE);
+        }
+        page++;
+    }
+}
+
+// Returns the id of the zone that owns the page of ptr, PAGE_MAP_ZONE_NONE if none.
+uint8_t PageMap_zone_get(void *ptr)
+{
+    return ((uint8_t)(entry_get(ptr) & PAGE_MAP_ZONE_MASK));
+}
+
+// Returns the id of the arena that owns the page of ptr.
+// Only meaningful if the page belongs to a zone.
+uint8_t PageMap_arena_get(void *ptr)
+{
+    return ((uint8_t)((entry_get(ptr) & PAGE_MAP_ARENA_MASK) >> PAGE_MAP_ARENA_SHIFT));
+}
+
+// Returns the owner registered for the page of ptr if the page belongs to zone, NULL otherwise.
+void *PageMap_owner_get(void *ptr, uint8_t zone)
+{
+    uintptr_t entry = entry_get(ptr);
+
+    if ((entry & PAGE_MAP_ZONE_MASK) != zone)
+    {
+        return (NULL);
+    }
+    return ((void *)(entry & PAGE_MAP_OWNER_MASK));
+}
@@ -0,0 +1,120 @@
+#include "../../main/inc_pub/malloc.h"
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+
+// The libc allocation functions, built on the ft_ ones. Only libft_malloc.so holds this file,
+// so LD_PRELOAD=./libft_malloc.so hands every allocation of a program, libc and the loader included, to the zones.
+// Nothing reached from here calls stdio or the libc malloc: the first call may come from inside either of them.
+// Failures set errno to ENOMEM like the libc functions do.
+
+// Returns a block of size bytes starting on a multiple of align, a power of two.
+static void *aligned_get(size_t align, size_t size)
+{
+    void *ptr = ft_aligned_alloc(align, (size == 0u) ? (1u) : (size));
+
+    if (ptr == NULL)
+    {
+        errno = ENOMEM;
+    }
+    return (ptr);
+}
+
+// malloc(0) returns a block that can be freed, like the libc one.
+void *malloc(size_t size)
+{
+    void *ptr = ft_malloc((size == 0u) ? (1u) : (size));
+
+    if (ptr == NULL)
+    {
+        errno = ENOMEM;
+    }
+    return (ptr);
+}
+
+void free(void *ptr)
+{
+    ft_free(ptr);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    void *new_ptr;
+
+    if ((ptr == NULL) || (size == 0u))
+    {
+        return ((ptr == NULL) ? (malloc(size)) : (ft_realloc(ptr, 0u))); // realloc(ptr, 0) frees ptr
+    }
+    new_ptr = ft_realloc(ptr, size);
+    if (new_ptr == NULL)
+    {
+        errno = ENOMEM;
+    }
+    return (new_ptr);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    void *ptr = ft_calloc(((count == 0u) || (size == 0u)) ? (1u) : (count), ((count == 0u) || (size == 0u)) ? (1u) : (size));
+
+    if (ptr == NULL)
+    {
+        errno = ENOMEM;
+    }
+    return (ptr);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    return (ft_posix_memalign(memptr, alignment, (size == 0u) ? (1u) : (size)));
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    if ((alignment == 0u) || ((alignment & (alignment - 1u)) != 0u))
+    {
+        errno = EINVAL;
+        return (NULL); // Not a power of two
+    }
+    return (aligned_get(alignment, size));
+}
+
+// A non power of two alignment is rounded up to the next power of two, like the libc memalign does.
+void *memalign(size_t alignment, size_t size)
+{
+    size_t align = FT_MALLOC_ALIGNMENT;
+
+    while (align < alignment)
+    {
+        if (align > SIZE_MAX / 2u)
+        {
+            errno = EINVAL;
+            return (NULL);
+        }
+        align *= 2u;
+    }
+    return (aligned_get(align, size));
+}
+
+void *valloc(size_t size)
+{
+    return (aligned_get((size_t)sysconf(_SC_PAGESIZE), size));
+}
+
+// The size is rounded up to a whole number of pages.
+void *pvalloc(size_t size)
+{
+    const size_t page_size = (size_t)sysconf(_SC_PAGESIZE); // Get the page size
+
+    if (size > SIZE_MAX - page_size)
+    {
+        errno = ENOMEM;
+        return (NULL);
+    }
+    return (aligned_get(page_size, ((size + page_size - 1u) / page_size) * page_size));
+}
+
+size_t malloc_usable_size(void *ptr)
+{
+    return (ft_malloc_usable_size(ptr));
+}
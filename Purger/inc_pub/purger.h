@@ -0,0 +1,14 @@
+#ifndef IG_PURGER_H
+#define IG_PURGER_H
+
+#include <stdlib.h>
+#include <inttypes.h>
+
+size_t Purger_tick(void);
+size_t Purger_trim(size_t pad);
+short Purger_interval_set(size_t interval_ms);
+void Purger_fork_lock(void);
+void Purger_fork_unlock(short child);
+
+
+#endif // IG_PURGER_H
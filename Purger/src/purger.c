@@ -0,0 +1,140 @@
+#include "../inc_pub/purger.h"
+#include "../../Arena/inc_pub/arena.h"
+#include "../../MapCache/inc_pub/map_cache.h"
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
+
+// Free blocks of the small and big zones keep their pages until a purge tick gives them back.
+// Each tick releases the pages of the blocks that stayed free since the previous tick,
+// so with ticks every interval a page goes back to the system between one and two intervals after its block was freed.
+// Ticks are run by ft_malloc_purge or by an optional background thread, the free path never makes a syscall for it.
+
+size_t purger_interval_ms = 0u; // Time between two ticks of the thread, 0 if there is no thread
+short purger_running = 0; // 1 while the thread is alive
+pthread_mutex_t purger_lock = PTHREAD_MUTEX_INITIALIZER; // Protects the interval and the running flag
+pthread_cond_t purger_cond = PTHREAD_COND_INITIALIZER; // Wakes the thread up when the interval changes
+
+// Body of the background thread: runs a tick every interval until the interval is set to 0.
+static void *purger_run(void *arg)
+{
+    struct timespec deadline;
+    int ret;
+
+    (void)arg;
+    pthread_mutex_lock(&purger_lock);
+    while (purger_interval_ms != 0u)
+    {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += (time_t)(purger_interval_ms / 1000u);
+        deadline.tv_nsec += (long)(purger_interval_ms % 1000u) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L)
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        ret = pthread_cond_timedwait(&purger_cond, &purger_lock, &deadline);
+        if ((ret == ETIMEDOUT) && (purger_interval_ms != 0u))
+        {
+            pthread_mutex_unlock(&purger_lock);
+            Purger_tick();
+            pthread_mutex_lock(&purger_lock);
+        }
+    }
+    purger_running = 0;
+    pthread_mutex_unlock(&purger_lock);
+    return (NULL);
+}
+
+// Gives back the pages of the blocks of every arena that stayed free for a whole tick,
+// and the empty mappings kept past their decay period.
+// Returns the number of bytes given back to the system.
+size_t Purger_tick(void)
+{
+    arena_t *arena;
+    size_t purged = 0u;
+
+    for (size_t i = 0u; i < Arena_count_get(); i++)
+    {
+        arena = Arena_get((uint8_t)i);
+        Arena_lock(arena);
+        Arena_remote_drain(arena);
+        purged += ZoneAllocatorSmall_purge(&arena->small);
+        purged += ZoneAllocatorBig_purge(&arena->big);
+        Arena_unlock(arena);
+    }
+    purged += MapCache_purge();
+    return (purged);
+}
+
+// Gives back every empty mapping and the pages of every free block, whatever their age,
+// except pad bytes of slack: the zones of the first arenas keep theirs first, then the kept mappings.
+// Returns the number of bytes given back to the system.
+size_t Purger_trim(size_t pad)
+{
+    arena_t *arena;
+    size_t released = 0u;
+
+    for (size_t i = 0u; i < Arena_count_get(); i++)
+    {
+        arena = Arena_get((uint8_t)i);
+        Arena_lock(arena);
+        Arena_remote_drain(arena);
+        released += ZoneAllocatorTiny_trim(&arena->tiny, &pad);
+        released += ZoneAllocatorSmall_trim(&arena->small, &pad);
+        released += ZoneAllocatorBig_trim(&arena->big, &pad);
+        Arena_unlock(arena);
+    }
+    released += MapCache_trim(pad);
+    return (released);
+}
+
+// Sets the time between two ticks of the background thread, the thread is started if needed.
+// 0 stops the thread.
+// Returns 0 on success, -1 if the thread could not be started.
+short Purger_interval_set(size_t interval_ms)
+{
+    pthread_attr_t attr;
+    pthread_t thread;
+    short ret = 0;
+
+    pthread_mutex_lock(&purger_lock);
+    purger_interval_ms = interval_ms;
+    if ((interval_ms != 0u) && (purger_running == 0))
+    {
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        if (pthread_create(&thread, &attr, purger_run, NULL) == 0)
+        {
+            purger_running = 1;
+        }
+        else
+        {
+            purger_interval_ms = 0u;
+            ret = -1;
+        }
+        pthread_attr_destroy(&attr);
+    }
+    pthread_cond_signal(&purger_cond); // A running thread picks the new interval up
+    pthread_mutex_unlock(&purger_lock);
+    return (ret);
+}
+
+// Takes the purger lock so a fork cannot copy it held, Purger_fork_unlock releases it.
+void Purger_fork_lock(void)
+{
+    pthread_mutex_lock(&purger_lock);
+}
+
+// Releases the purger lock after a fork. The thread is not copied to the child:
+// the child forgets it and gets a fresh condition, the thread may have been waiting on the old one.
+void Purger_fork_unlock(short child)
+{
+    if (child != 0)
+    {
+        purger_interval_ms = 0u;
+        purger_running = 0;
+        pthread_cond_init(&purger_cond, NULL);
+    }
+    pthread_mutex_unlock(&purger_lock);
+}
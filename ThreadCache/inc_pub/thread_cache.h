@@ -0,0 +1,20 @@
+#ifndef IG_THREAD_CACHE_H
+#define IG_THREAD_CACHE_H
+
+#include <stdlib.h>
+#include <inttypes.h>
+
+#define THREAD_CACHE_SIZE_MAX 1024u // Largest request served by the thread cache
+#define THREAD_CACHE_COUNT_DEFAULT 32u // Default number of blocks kept per bin
+#define THREAD_CACHE_COUNT_MAX 4096u // Upper bound of the number of blocks kept per bin
+
+void *ThreadCache_alloc(size_t size);
+short ThreadCache_free(void *ptr, uint8_t zone);
+short ThreadCache_free_sized(void *ptr, uint8_t zone, size_t size);
+void ThreadCache_flush(void);
+
+short ThreadCache_capacity_set(size_t count);
+void ThreadCache_stats_get(size_t *hits, size_t *misses, size_t *flushes);
+
+
+#endif // IG_THREAD_CACHE_H
@@ -0,0 +1,370 @@
+#include "../inc_pub/thread_cache.h"
+#include "../../Arena/inc_pub/arena.h"
+#include "../../PageMap/inc_pub/page_map.h"
+#include "../../VirtualRegion/inc_pub/virtual_region.h"
+#include <pthread.h>
+#include <inttypes.h>
+
+// Per thread cache of tiny and small blocks, binned by 16 byte size class.
+// Blocks in a bin stay allocated from the zone point of view, the bin links them
+// through their first word and tags them in their second one. Allocations and frees served by a bin take no lock,
+// misses refill or flush half a bin under a single arena lock.
+// A free checks the block is live in its zone before caching it, and a block already carrying the tag is looked up
+// in its bin, so a double free is rejected like the zones reject it instead of caching the block twice.
+
+#define THREAD_CACHE_STEP 16u // Size difference between two bins
+#define THREAD_CACHE_BIN_COUNT (THREAD_CACHE_SIZE_MAX / THREAD_CACHE_STEP) // Number of bins
+#define THREAD_CACHE_BIN_INDEX(size) (((size) - 1u) / THREAD_CACHE_STEP) // Bin serving a requested size
+#define THREAD_CACHE_BIN_SIZE(bin_index) (((bin_index) + 1u) * THREAD_CACHE_STEP) // Smallest capacity of a block of the bin
+#define THREAD_CACHE_TAG_SALT (uintptr_t)0x9e3779b97f4a7c15u // Mixed with an address of the library, the tag differs between runs
+
+typedef struct thread_cache_block thread_cache_block_t;
+
+struct thread_cache_block
+{
+    thread_cache_block_t *next; // Next cached block of the same bin
+    uintptr_t tag; // thread_cache_tag while the block is cached
+};
+
+typedef struct
+{
+    thread_cache_block_t *head; // Last cached block
+    size_t count; // Number of cached blocks
+} thread_cache_bin_t;
+
+typedef struct
+{
+    thread_cache_bin_t bins[THREAD_CACHE_BIN_COUNT]; // Cached blocks per size class
+    size_t hits; // Allocations served by a bin, not yet published
+    size_t misses; // Allocations that had to refill a bin, not yet published
+    size_t flushes; // Frees that had to flush a bin, not yet published
+    uint8_t state; // THREAD_CACHE_STATE_*
+} thread_cache_t;
+
+#define THREAD_CACHE_STATE_NEW 0u // Drain on exit not registered yet
+#define THREAD_CACHE_STATE_ACTIVE 1u // Cache in use
+#define THREAD_CACHE_STATE_DEAD 2u // Thread is exiting, the cache is bypassed
+
+__thread thread_cache_t thread_cache; // Cache of the calling thread
+size_t thread_cache_capacity = THREAD_CACHE_COUNT_DEFAULT; // Blocks kept per bin, 0 disables the cache
+size_t thread_cache_hits = 0u; // Published hits of every thread
+size_t thread_cache_misses = 0u; // Published misses of every thread
+size_t thread_cache_flushes = 0u; // Published flushes of every thread
+pthread_key_t thread_cache_key; // Runs the drain when a thread exits
+uintptr_t thread_cache_tag = 0u; // Marks a cached block, set with the key
+pthread_once_t thread_cache_once = PTHREAD_ONCE_INIT;
+
+// Adds the counters of the calling thread to the published ones.
+static void stats_publish(thread_cache_t *cache)
+{
+    __atomic_fetch_add(&thread_cache_hits, cache->hits, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&thread_cache_misses, cache->misses, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&thread_cache_flushes, cache->flushes, __ATOMIC_RELAXED);
+    cache->hits = 0u;
+    cache->misses = 0u;
+    cache->flushes = 0u;
+}
+
+// Gives count blocks of a bin back to the arenas that own them.
+// Blocks of other arenas go to their remote lists, consecutive blocks of the same arena
+// are released under one lock.
+static void bin_flush(thread_cache_bin_t *bin, size_t count)
+{
+    thread_cache_block_t *block;
+    arena_t *locked = NULL;
+    arena_t *arena;
+
+    while ((count > 0u) && (bin->head != NULL))
+    {
+        block = bin->head;
+        bin->head = block->next;
+        bin->count--;
+        count--;
+        arena = Arena_get(PageMap_arena_get(block));
+        if (Arena_remote_free(arena, block) == 0)
+        {
+            continue; // Owned by another arena, pushed on its remote list
+        }
+        if (arena != locked)
+        {
+            if (locked != NULL)
+            {
+                Arena_unlock(locked);
+            }
+            Arena_lock(arena);
+            locked = arena;
+        }
+        Arena_block_free(arena, block, VirtualRegion_zone_get(block));
+    }
+    if (locked != NULL)
+    {
+        Arena_unlock(locked);
+    }
+}
+
+// Gives every cached block back when the thread exits.
+static void cache_drain(void *arg)
+{
+    thread_cache_t *cache = arg;
+
+    for (size_t i = 0u; i < THREAD_CACHE_BIN_COUNT; i++)
+    {
+        bin_flush(&cache->bins[i], cache->bins[i].count);
+    }
+    stats_publish(cache);
+    cache->state = THREAD_CACHE_STATE_DEAD;
+}
+
+// Gives every block cached by the calling thread back to the arenas.
+void ThreadCache_flush(void)
+{
+    for (size_t i = 0u; i < THREAD_CACHE_BIN_COUNT; i++)
+    {
+        bin_flush(&thread_cache.bins[i], thread_cache.bins[i].count);
+    }
+}
+
+static void cache_key_create(void)
+{
+    thread_cache_tag = (uintptr_t)&thread_cache_tag ^ THREAD_CACHE_TAG_SALT;
+    pthread_key_create(&thread_cache_key, cache_drain);
+}
+
+// Returns the cache of the calling thread, NULL if the cache must be bypassed.
+static thread_cache_t *cache_get(void)
+{
+    thread_cache_t *cache = &thread_cache;
+
+    if (cache->state == THREAD_CACHE_STATE_NEW)
+    {
+        cache->state = THREAD_CACHE_STATE_ACTIVE; // Set first, registering the key may allocate
+        pthread_once(&thread_cache_once, cache_key_create);
+        pthread_setspecific(thread_cache_key, cache);
+    }
+    if (cache->state == THREAD_CACHE_STATE_DEAD)
+    {
+        return (NULL);
+    }
+    return (cache);
+}
+
+// Allocates half a bin of blocks of the bin size class under one arena lock.
+// One block is returned, the others are cached.
+static void *bin_refill(thread_cache_bin_t *bin, size_t bin_index)
+{
+    arena_t *arena = Arena_thread_get();
+    size_t size = THREAD_CACHE_BIN_SIZE(bin_index);
+    size_t count = __atomic_load_n(&thread_cache_capacity, __ATOMIC_RELAXED) / 2u;
+    thread_cache_block_t *block;
+    void *ret = NULL;
+
+    count = (count == 0u) ? (1u) : (count);
+    Arena_lock(arena);
+    Arena_remote_drain(arena);
+    for (size_t i = 0u; i < count; i++)
+    {
+        block = NULL;
+        if (size <= TINY_ALLOC_SIZE)
+        {
+            block = ZoneAllocatorTiny_alloc(&arena->tiny, size);
+        }
+        if (block == NULL)
+        {
+            block = ZoneAllocatorSmall_alloc(&arena->small, size);
+        }
+        if (block == NULL)
+        {
+            break; // Zones are exhausted, keep what we got
+        }
+        if (ret == NULL)
+        {
+            ret = block;
+        }
+        else
+        {
+            block->next = bin->head;
+            block->tag = thread_cache_tag;
+            bin->head = block;
+            bin->count++;
+        }
+    }
+    Arena_unlock(arena);
+    return (ret);
+}
+
+// Allocates a tiny or small block from the bin of its size class.
+// Returns NULL if the size is not cached or the zones are exhausted.
+void *ThreadCache_alloc(size_t size)
+{
+    thread_cache_t *cache;
+    thread_cache_bin_t *bin;
+    thread_cache_block_t *block;
+    size_t bin_index;
+
+    if ((size == 0u) || (size > THREAD_CACHE_SIZE_MAX))
+    {
+        return (NULL);
+    }
+    cache = cache_get();
+    if (cache == NULL)
+    {
+        return (NULL);
+    }
+    bin_index = THREAD_CACHE_BIN_INDEX(size);
+    bin = &cache->bins[bin_index];
+    block = bin->head;
+    if (block != NULL)
+    {
+        bin->head = block->next;
+        block->tag = 0u;
+        bin->count--;
+        cache->hits++;
+    }
+    else if (__atomic_load_n(&thread_cache_capacity, __ATOMIC_RELAXED) == 0u)
+    {
+        return (NULL); // Cache disabled, bins only drain
+    }
+    else
+    {
+        cache->misses++;
+        block = bin_refill(bin, bin_index);
+        stats_publish(cache);
+        if (block == NULL)
+        {
+            return (NULL);
+        }
+    }
+    if (VirtualRegion_zone_get(block) == PAGE_MAP_ZONE_TINY)
+    {
+        ZoneAllocatorTiny_used_set(block, size);
+    }
+    else
+    {
+        ZoneAllocatorSmall_used_set(block, size);
+    }
+    return (block);
+}
+
+// Returns 1 if block is cached in bin. Only walked for a block carrying the tag, which user data rarely does.
+static short bin_holds(const thread_cache_bin_t *bin, const thread_cache_block_t *block)
+{
+    for (const thread_cache_block_t *current = bin->head; current != NULL; current = current->next)
+    {
+        if (current == block)
+        {
+            return (1);
+        }
+    }
+    return (0);
+}
+
+// Keeps a freed block in the bin of the given capacity, a multiple of the step the block holds.
+// A full bin is first flushed by half to the owning arenas.
+// Returns 0 if the block was taken, -1 if the caller has to free it, -2 if the block is already cached.
+static short block_put(thread_cache_t *cache, void *ptr, size_t capacity)
+{
+    thread_cache_bin_t *bin;
+    thread_cache_block_t *block = ptr;
+    size_t max_count;
+
+    if ((capacity < THREAD_CACHE_STEP) || (capacity > THREAD_CACHE_SIZE_MAX))
+    {
+        return (-1);
+    }
+    bin = &cache->bins[(capacity / THREAD_CACHE_STEP) - 1u]; // Every block of a bin fits its whole class
+    if ((block->tag == thread_cache_tag) && (bin_holds(bin, block) != 0))
+    {
+        return (-2); // Double free
+    }
+    max_count = __atomic_load_n(&thread_cache_capacity, __ATOMIC_RELAXED);
+    if (max_count == 0u)
+    {
+        bin_flush(bin, bin->count); // Cache disabled, give back what is left
+        return (-1);
+    }
+    if (bin->count >= max_count)
+    {
+        cache->flushes++;
+        bin_flush(bin, bin->count - (max_count / 2u));
+        stats_publish(cache);
+    }
+    block->next = bin->head;
+    block->tag = thread_cache_tag;
+    bin->head = block;
+    bin->count++;
+    return (0);
+}
+
+// Returns the capacity of a live tiny or small block, 0 if it is not allocated.
+static size_t block_capacity_get(void *ptr, uint8_t zone)
+{
+    return ((zone == PAGE_MAP_ZONE_TINY) ? (ZoneAllocatorTiny_capacity_get(ptr)) : (ZoneAllocatorSmall_capacity_get(ptr)));
+}
+
+// Keeps a freed tiny or small block in the bin of its capacity.
+// Returns 0 if the block was taken, -1 if the caller has to free it, -2 if it is not an allocated block.
+short ThreadCache_free(void *ptr, uint8_t zone)
+{
+    thread_cache_t *cache;
+    size_t capacity;
+
+    if ((zone != PAGE_MAP_ZONE_TINY) && (zone != PAGE_MAP_ZONE_SMALL))
+    {
+        return (-1);
+    }
+    cache = cache_get();
+    if (cache == NULL)
+    {
+        return (-1);
+    }
+    capacity = block_capacity_get(ptr, zone);
+    if (capacity == 0u)
+    {
+        return (-2); // Not a live block, as the zone free would tell
+    }
+    return (block_put(cache, ptr, capacity));
+}
+
+// Keeps a freed tiny or small block of at least size bytes in the bin of size.
+// The capacity is a multiple of the step and holds size, so it holds the whole bin class too.
+// It is still read, to check the block is live and holds size before it is cached.
+// Returns 0 if the block was taken, -1 if the caller has to free it, -2 if it is not an allocated block of that size.
+short ThreadCache_free_sized(void *ptr, uint8_t zone, size_t size)
+{
+    thread_cache_t *cache;
+
+    if (((zone != PAGE_MAP_ZONE_TINY) && (zone != PAGE_MAP_ZONE_SMALL)) || (size == 0u) || (size > THREAD_CACHE_SIZE_MAX))
+    {
+        return (-1);
+    }
+    cache = cache_get();
+    if (cache == NULL)
+    {
+        return (-1);
+    }
+    if (block_capacity_get(ptr, zone) < size)
+    {
+        return (-2); // Not a live block, or smaller than size
+    }
+    return (block_put(cache, ptr, THREAD_CACHE_BIN_SIZE(THREAD_CACHE_BIN_INDEX(size))));
+}
+
+// Sets the number of blocks kept per bin, 0 disables the cache.
+// Threads trim their bins to the new capacity on their next free of that size class.
+short ThreadCache_capacity_set(size_t count)
+{
+    if (count > THREAD_CACHE_COUNT_MAX)
+    {
+        return (-1);
+    }
+    __atomic_store_n(&thread_cache_capacity, count, __ATOMIC_RELAXED);
+    return (0);
+}
+
+// Returns the published counters of every thread plus the pending ones of the calling thread.
+void ThreadCache_stats_get(size_t *hits, size_t *misses, size_t *flushes)
+{
+    *hits = __atomic_load_n(&thread_cache_hits, __ATOMIC_RELAXED) + thread_cache.hits;
+    *misses = __atomic_load_n(&thread_cache_misses, __ATOMIC_RELAXED) + thread_cache.misses;
+    *flushes = __atomic_load_n(&thread_cache_flushes, __ATOMIC_RELAXED) + thread_cache.flushes;
+}
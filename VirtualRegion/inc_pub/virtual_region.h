@@ -0,0 +1,21 @@
+#ifndef IG_VIRTUAL_REGION_H
+#define IG_VIRTUAL_REGION_H
+
+#include <stdlib.h>
+#include <inttypes.h>
+
+#define VIRTUAL_REGION_TINY_SIZE ((size_t)4u << 30u) // Address space reserved for the tiny slabs
+#define VIRTUAL_REGION_SMALL_SIZE ((size_t)12u << 30u) // Address space reserved for the small zones
+#define VIRTUAL_REGION_BIG_SIZE ((size_t)48u << 30u) // Address space reserved for the big maps
+#define VIRTUAL_REGION_COMMIT_CHUNK ((size_t)16u << 20u) // Address space made accessible at once past the committed end of a range
+
+void *VirtualRegion_map(uint8_t zone, size_t size, size_t align);
+short VirtualRegion_unmap(void *start, size_t size);
+
+uint8_t VirtualRegion_range_get(const void *ptr);
+uint8_t VirtualRegion_zone_get(void *ptr);
+void VirtualRegion_fork_lock(void);
+void VirtualRegion_fork_unlock(void);
+
+
+#endif // IG_VIRTUAL_REGION_H
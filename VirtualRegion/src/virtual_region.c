@@ -0,0 +1,348 @@
+#include "../inc_pub/virtual_region.h"
+#include "../../PageMap/inc_pub/page_map.h"
+#include <sys/mman.h>
+#include <pthread.h>
+#include <unistd.h>
+
+// One PROT_NONE region is reserved on first use and cut into a fixed range per zone kind,
+// so the zone of a pointer is found by comparing it to the bounds of the ranges.
+// Each range hands out address space from its free extents first, then from its frontier.
+// Address space past the frontier is made accessible with mprotect VIRTUAL_REGION_COMMIT_CHUNK bytes at a time,
+// so a zone mapping costs no syscall while the committed chunk lasts, and the pages only count once touched.
+// A range given back is replaced by a fresh PROT_NONE mapping, its pages go back to the system at once.
+// When the region can not be reserved or a range is full the caller maps outside of the region,
+// lookups of pointers outside of the region then go through the page map.
+
+#define VIRTUAL_REGION_RANGE_COUNT 3u // Tiny, small and big ranges
+#define VIRTUAL_REGION_SIZE (VIRTUAL_REGION_TINY_SIZE + VIRTUAL_REGION_SMALL_SIZE + VIRTUAL_REGION_BIG_SIZE) // Reserved address space
+#define VIRTUAL_REGION_ALIGN ((size_t)2u << 20u) // Alignment of the region, keeps the ranges huge page aligned
+#define VIRTUAL_REGION_EXTENT_POOL ((size_t)64u << 10u) // Bytes of extent records mapped at once
+
+typedef struct virtual_region_extent virtual_region_extent_t;
+
+// Free address space of a range, the extents of a range are sorted by address and never touch each other
+struct virtual_region_extent
+{
+    uintptr_t start; // First byte of the extent
+    uintptr_t end; // First byte past the extent
+    virtual_region_extent_t *next; // Next extent of the range, or next unused record
+    virtual_region_extent_t *prev; // Previous extent of the range
+};
+
+// One range of the region, serving a single zone kind
+typedef struct
+{
+    uintptr_t start; // First byte of the range
+    uintptr_t end; // First byte past the range
+    uintptr_t frontier; // Address space past it was never handed out or has been given back
+    uintptr_t committed; // Address space below it and past the frontier is accessible
+    virtual_region_extent_t *extents; // Free address space below the frontier
+} virtual_region_range_t;
+
+uintptr_t virtual_region_base = 0u; // Start of the region, 0 until it is reserved
+short virtual_region_failed = 0; // 1 if the region could not be reserved
+short virtual_region_spilled = 0; // 1 once a zone was mapped outside of the region
+virtual_region_range_t virtual_region_ranges[VIRTUAL_REGION_RANGE_COUNT]; // Ranges by zone id - 1
+virtual_region_extent_t *virtual_region_records = NULL; // Unused extent records
+pthread_mutex_t virtual_region_lock = PTHREAD_MUTEX_INITIALIZER; // Protects the ranges and the records
+
+// Reserves the region and cuts it into ranges. Returns 0 on success, -1 if the region could not be reserved.
+static short region_reserve(void)
+{
+    const size_t sizes[VIRTUAL_REGION_RANGE_COUNT] = {VIRTUAL_REGION_TINY_SIZE, VIRTUAL_REGION_SMALL_SIZE, VIRTUAL_REGION_BIG_SIZE};
+    uint8_t *map;
+    uintptr_t start;
+    size_t head;
+
+    map = mmap(NULL, VIRTUAL_REGION_SIZE + VIRTUAL_REGION_ALIGN, PROT_NONE, MAP_ANONYMOUS | MAP_PRIVATE | MAP_NORESERVE, -1, 0);
+    if (map == MAP_FAILED)
+    {
+        virtual_region_failed = 1;
+        return (-1);
+    }
+    head = (VIRTUAL_REGION_ALIGN - ((uintptr_t)map % VIRTUAL_REGION_ALIGN)) % VIRTUAL_REGION_ALIGN;
+    if (head != 0u)
+    {
+        munmap((void *)map, head);
+    }
+    munmap((void *)(map + head + VIRTUAL_REGION_SIZE), VIRTUAL_REGION_ALIGN - head);
+    start = (uintptr_t)map + head;
+    for (size_t i = 0u; i < VIRTUAL_REGION_RANGE_COUNT; i++)
+    {
+        virtual_region_ranges[i].start = start;
+        virtual_region_ranges[i].end = start + sizes[i];
+        virtual_region_ranges[i].frontier = start;
+        virtual_region_ranges[i].committed = start;
+        virtual_region_ranges[i].extents = NULL;
+        start += sizes[i];
+    }
+    __atomic_store_n(&virtual_region_base, (uintptr_t)map + head, __ATOMIC_RELEASE);
+    return (0);
+}
+
+// Returns an unused extent record, NULL if no more could be mapped.
+static virtual_region_extent_t *record_get(void)
+{
+    virtual_region_extent_t *record = virtual_region_records;
+
+    if (record == NULL)
+    {
+        record = mmap(NULL, VIRTUAL_REGION_EXTENT_POOL, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+        if (record == MAP_FAILED)
+        {
+            return (NULL);
+        }
+        for (size_t i = 1u; i < VIRTUAL_REGION_EXTENT_POOL / sizeof(virtual_region_extent_t); i++)
+        {
+            record[i].next = virtual_region_records;
+            virtual_region_records = &record[i];
+        }
+        return (record);
+    }
+    virtual_region_records = record->next;
+    return (record);
+}
+
+static void record_put(virtual_region_extent_t *record)
+{
+    record->next = virtual_region_records;
+    virtual_region_records = record;
+}
+
+static void extent_remove(virtual_region_range_t *range, virtual_region_extent_t *extent)
+{
+    if (extent->prev == NULL)
+    {
+        range->extents = extent->next;
+    }
+    else
+    {
+        extent->prev->next = extent->next;
+    }
+    if (extent->next != NULL)
+    {
+        extent->next->prev = extent->prev;
+    }
+    record_put(extent);
+}
+
+// Adds [start, end) to the free extents of a range, merged with the extents it touches.
+// Free address space that reaches the frontier moves the frontier back instead.
+// Returns 0 on success, -1 if no record was left for a new extent (the address space is then lost).
+static short extent_add(virtual_region_range_t *range, uintptr_t start, uintptr_t end)
+{
+    virtual_region_extent_t *prev = NULL;
+    virtual_region_extent_t *next = range->extents;
+    virtual_region_extent_t *extent;
+
+    while ((next != NULL) && (next->start < start))
+    {
+        prev = next;
+        next = next->next;
+    }
+    if ((prev != NULL) && (prev->end == start))
+    {
+        extent = prev;
+        extent->end = end;
+        if ((next != NULL) && (next->start == end))
+        {
+            extent->end = next->end;
+            extent_remove(range, next);
+        }
+    }
+    else if ((next != NULL) && (next->start == end))
+    {
+        extent = next;
+        extent->start = start;
+    }
+    else
+    {
+        extent = record_get();
+        if (extent == NULL)
+        {
+            return (-1);
+        }
+        extent->start = start;
+        extent->end = end;
+        extent->prev = prev;
+        extent->next = next;
+        if (prev == NULL)
+        {
+            range->extents = extent;
+        }
+        else
+        {
+            prev->next = extent;
+        }
+        if (next != NULL)
+        {
+            next->prev = extent;
+        }
+    }
+    if (extent->end == range->frontier)
+    {
+        range->frontier = extent->start;
+        range->committed = extent->start; // Part of it is PROT_NONE again, it is committed anew when handed out
+        extent_remove(range, extent);
+    }
+    return (0);
+}
+
+// Takes size bytes aligned to align from the first free extent of a range that holds them.
+// Returns the start of the address space, 0 if no extent holds it.
+static uintptr_t extent_take(virtual_region_range_t *range, size_t size, size_t align)
+{
+    virtual_region_extent_t *extent = range->extents;
+    uintptr_t start;
+    uintptr_t end;
+
+    while (extent != NULL)
+    {
+        start = ((extent->start + align - 1u) / align) * align;
+        if ((start <= extent->end) && (extent->end - start >= size))
+        {
+            end = extent->end;
+            if (start != extent->start)
+            {
+                extent->end = start; // Head left before the aligned start
+            }
+            else
+            {
+                extent_remove(range, extent);
+            }
+            if (start + size != end)
+            {
+                extent_add(range, start + size, end); // Tail left past the block
+            }
+            return (start);
+        }
+        extent = extent->next;
+    }
+    return (0u);
+}
+
+// Takes size bytes aligned to align past the frontier of a range, committing address space by chunks.
+// The address space skipped to align the start becomes a free extent.
+// Returns the start of the address space, 0 if the range is full or the system refused to commit it.
+static uintptr_t frontier_take(virtual_region_range_t *range, size_t size, size_t align)
+{
+    uintptr_t start = ((range->frontier + align - 1u) / align) * align;
+    uintptr_t frontier = range->frontier;
+    size_t commit;
+
+    if ((start > range->end) || (range->end - start < size))
+    {
+        return (0u); // The range is full
+    }
+    if (start + size > range->committed)
+    {
+        commit = (((start + size - range->committed) + VIRTUAL_REGION_COMMIT_CHUNK - 1u) / VIRTUAL_REGION_COMMIT_CHUNK) * VIRTUAL_REGION_COMMIT_CHUNK;
+        commit = (commit < range->end - range->committed) ? (commit) : (range->end - range->committed);
+        if (mprotect((void *)range->committed, commit, PROT_READ | PROT_WRITE) != 0)
+        {
+            return (0u);
+        }
+        range->committed += commit;
+    }
+    range->frontier = start + size;
+    if (start != frontier)
+    {
+        extent_add(range, frontier, start);
+    }
+    return (start);
+}
+
+// Hands out size bytes of the range of a zone, aligned to align (0 for the page size) and accessible.
+// Returns NULL if the region could not be reserved or the range is full, the caller then maps outside of the region.
+void *VirtualRegion_map(uint8_t zone, size_t size, size_t align)
+{
+    virtual_region_range_t *range;
+    uintptr_t start = 0u;
+
+    if ((zone < PAGE_MAP_ZONE_TINY) || (zone > PAGE_MAP_ZONE_BIG))
+    {
+        return (NULL);
+    }
+    align = (align == 0u) ? ((size_t)sysconf(_SC_PAGESIZE)) : (align);
+    range = &virtual_region_ranges[zone - PAGE_MAP_ZONE_TINY];
+    pthread_mutex_lock(&virtual_region_lock);
+    if ((virtual_region_base != 0u) || ((virtual_region_failed == 0) && (region_reserve() == 0)))
+    {
+        start = extent_take(range, size, align);
+        if ((start != 0u) && (mprotect((void *)start, size, PROT_READ | PROT_WRITE) != 0))
+        {
+            extent_add(range, start, start + size);
+            start = 0u;
+        }
+        else if (start == 0u)
+        {
+            start = frontier_take(range, size, align);
+        }
+    }
+    if (start == 0u)
+    {
+        __atomic_store_n(&virtual_region_spilled, 1, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&virtual_region_lock);
+    return ((void *)start);
+}
+
+// Gives back address space handed out by VirtualRegion_map, its pages go back to the system at once.
+// Returns 0 on success, -1 if start is outside of the region and has to be unmapped by the caller.
+short VirtualRegion_unmap(void *start, size_t size)
+{
+    uint8_t zone = VirtualRegion_range_get(start);
+
+    if (zone == PAGE_MAP_ZONE_NONE)
+    {
+        return (-1);
+    }
+    mmap(start, size, PROT_NONE, MAP_ANONYMOUS | MAP_PRIVATE | MAP_NORESERVE | MAP_FIXED, -1, 0); // Drops the pages, keeps the reservation
+    pthread_mutex_lock(&virtual_region_lock);
+    extent_add(&virtual_region_ranges[zone - PAGE_MAP_ZONE_TINY], (uintptr_t)start, (uintptr_t)start + size);
+    pthread_mutex_unlock(&virtual_region_lock);
+    return (0);
+}
+
+// Returns the zone whose range holds ptr, PAGE_MAP_ZONE_NONE if ptr is outside of the region.
+// Only the bounds of the ranges are compared, ptr may be address space that is not handed out.
+uint8_t VirtualRegion_range_get(const void *ptr)
+{
+    uintptr_t base = __atomic_load_n(&virtual_region_base, __ATOMIC_ACQUIRE);
+    uintptr_t offset = (uintptr_t)ptr - base;
+
+    if ((base == 0u) || ((uintptr_t)ptr < base) || (offset >= VIRTUAL_REGION_SIZE))
+    {
+        return (PAGE_MAP_ZONE_NONE);
+    }
+    if (offset < VIRTUAL_REGION_TINY_SIZE)
+    {
+        return (PAGE_MAP_ZONE_TINY);
+    }
+    return ((offset < VIRTUAL_REGION_TINY_SIZE + VIRTUAL_REGION_SMALL_SIZE) ? (PAGE_MAP_ZONE_SMALL) : (PAGE_MAP_ZONE_BIG));
+}
+
+// Returns the zone that owns the block ptr, PAGE_MAP_ZONE_NONE if ptr is not in any zone.
+// Pointers of the region are resolved by their range, the page map is only read
+// for pointers outside of it once a zone had to be mapped outside of the region.
+uint8_t VirtualRegion_zone_get(void *ptr)
+{
+    uint8_t zone = VirtualRegion_range_get(ptr);
+
+    if ((zone == PAGE_MAP_ZONE_NONE) && (__atomic_load_n(&virtual_region_spilled, __ATOMIC_RELAXED) != 0))
+    {
+        zone = PageMap_zone_get(ptr);
+    }
+    return (zone);
+}
+
+// Takes the region lock so a fork cannot copy it held, VirtualRegion_fork_unlock releases it in both processes.
+void VirtualRegion_fork_lock(void)
+{
+    pthread_mutex_lock(&virtual_region_lock);
+}
+
+void VirtualRegion_fork_unlock(void)
+{
+    pthread_mutex_unlock(&virtual_region_lock);
+}
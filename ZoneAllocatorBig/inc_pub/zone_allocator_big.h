@@ -2,15 +2,39 @@
 #define IG_ZONE_ALLOCATOR_BIG_H
 
 #include <stdlib.h>
+#include <inttypes.h>
 
 #define BIG_ALLOC_SIZE_MIN 4066u // Minimum size of the big allocation
+#define BIG_BIN_LOG_STEPS 8u // Bins per power of two
+#define BIG_BIN_COUNT 384u // Number of free block bins, sizes from 16 bytes to 2^52 bytes
+#define BIG_BIN_WORDS (BIG_BIN_COUNT / 64u) // Words of the bin occupancy bitmap
 
-void *ZoneAllocatorBig_alloc(size_t size);
-short ZoneAllocatorBig_free(void *ptr);
-void *ZoneAllocatorBig_realloc(void *ptr, size_t size);
+typedef struct big_map_header big_map_header_t;
+typedef struct big_block_header big_block_header_t;
+
+// State of one big zone, every arena owns one
+typedef struct
+{
+    big_map_header_t *start; // First map of the zone
+    big_map_header_t *end; // Last map of the zone
+    big_block_header_t *bins[BIG_BIN_COUNT]; // Free blocks of every map binned by size
+    uint64_t bin_bitmap[BIG_BIN_WORDS]; // Bit set if the bin holds at least one block
+    size_t purge_epoch; // Purge ticks run on the zone, stamped on the blocks it frees
+    uint8_t arena_id; // Arena registered as owner of the maps
+} big_zone_t;
+
+void *ZoneAllocatorBig_alloc(big_zone_t *zone, size_t size);
+void *ZoneAllocatorBig_calloc(big_zone_t *zone, size_t size);
+void *ZoneAllocatorBig_aligned_alloc(big_zone_t *zone, size_t size, size_t align);
+short ZoneAllocatorBig_free(big_zone_t *zone, void *ptr);
+void *ZoneAllocatorBig_realloc(big_zone_t *zone, void *ptr, size_t size);
 
 size_t ZoneAllocatorBig_size_get(void *ptr);
-void ZoneAllocatorBig_report(void);
+size_t ZoneAllocatorBig_capacity_get(void *ptr);
+void ZoneAllocatorBig_used_set(void *ptr, size_t size);
+size_t ZoneAllocatorBig_purge(big_zone_t *zone);
+size_t ZoneAllocatorBig_trim(big_zone_t *zone, size_t *pad);
+void ZoneAllocatorBig_report(big_zone_t *zone);
 
 
 #endif // IG_ZONE_ALLOCATOR_BIG_H
\ No newline at end of file
@@ -1,145 +1,365 @@
 #include "../inc_pub/zone_allocator_big.h"
 #include "../../print_utils/inc_pub/print_utils.h"
+#include "../../PageMap/inc_pub/page_map.h"
+#include "../../MapCache/inc_pub/map_cache.h"
 #include <sys/mman.h>
 #include <inttypes.h>
 #include <unistd.h>
+#include <string.h>
 #include <stdio.h>
 
-typedef struct big_block_header big_block_header_t;
-typedef struct big_map_header big_map_header_t;
-
+// Blocks of a map follow each other, the next block starts right after the payload.
+// A free block repeats its size in its last word (footer), and the block after it
+// has BIG_BLOCK_PREV_FREE set, so both neighbors of a block are reached in O(1).
+// Every map ends with a used block of size 0 that stops the walk.
 struct big_block_header
 {
-    size_t size; // Size of the block
+    size_t size; // Size of the block, BIG_BLOCK_USED and BIG_BLOCK_PREV_FREE packed in the low bits
     size_t used; // Used size of the block
-    big_block_header_t *next; // Pointer to the next block
 };
 
 struct big_map_header
 {
-    big_block_header_t *first_block; 	// Size of the block
     size_t cnt; 						// Used for mumap
 	size_t size;						// Used for mumap
     big_map_header_t *next; 			// Pointer to the next map
+    big_map_header_t *prev; 			// Pointer to the previous map
+	short huge;							// 1 if the map is made of huge pages, purges never split one
 };
 
+// Links of a free block, kept in its payload
+typedef struct
+{
+    big_block_header_t *next; // Next free block of the same bin
+    big_block_header_t *prev; // Previous free block of the same bin
+    size_t epoch; // Purge epoch of the zone when the block was freed, BIG_PURGED once its pages are given back
+} big_free_links_t;
+
 #define BIG_BLOCK_HEADER_SIZE sizeof(big_block_header_t) // Size of the header
 #define BIG_MAP_HEADER_SIZE sizeof(big_map_header_t) // Size of the header
 #define BIG_MAP_MIN_ALLOC 		10u //in pages
 #define BIG_MAP_DEFAULT_ALLOC 	20u //in pages
 
 #define BIG_ALLOC_ALIGMENT 16u // Alignment of the small allocation
+#define BIG_BLOCK_USED (size_t)1u // Size flag, the block is allocated
+#define BIG_BLOCK_PREV_FREE (size_t)2u // Size flag, the previous block is free and has a footer
+#define BIG_BLOCK_FLAGS (BIG_ALLOC_ALIGMENT - 1u) // Low bits of the size used by the flags
+#define BIG_BLOCK_SIZE_MIN (((sizeof(big_free_links_t) + sizeof(size_t) + BIG_ALLOC_ALIGMENT - 1u) / BIG_ALLOC_ALIGMENT) * BIG_ALLOC_ALIGMENT) // Smallest payload, a free block has to hold its links and footer
+#define BIG_MAP_HEADER_ALIGNED (((BIG_MAP_HEADER_SIZE + BIG_ALLOC_ALIGMENT - 1u) / BIG_ALLOC_ALIGMENT) * BIG_ALLOC_ALIGMENT) // Map header, keeps the blocks 16 byte aligned
+#define BIG_MAP_FIRST_BLOCK(map) ((big_block_header_t *)((uint8_t *)(map) + BIG_MAP_HEADER_ALIGNED)) // First block of a map
+#define BIG_SIZE(block) ((block)->size & ~BIG_BLOCK_FLAGS) // Size of a block without the flags
+#define BIG_LINKS(block) ((big_free_links_t *)((uint8_t *)(block) + BIG_BLOCK_HEADER_SIZE)) // Free list links of a free block
+#define BIG_NEXT(block) ((big_block_header_t *)((uint8_t *)(block) + BIG_BLOCK_HEADER_SIZE + BIG_SIZE(block))) // Physical next block
+#define BIG_FOOTER(block) ((size_t *)((uint8_t *)BIG_NEXT(block) - sizeof(size_t))) // Size copy at the end of a free block
+#define BIG_PURGED SIZE_MAX // Epoch of a free block whose pages were given back to the system
+
+// Free blocks of every map are kept in size bins, eight per power of two.
+// A request takes the first block of the first non empty bin whose blocks all fit,
+// so it never wastes more than an eighth of the block and never scans a list.
+
+// Returns the bin holding free blocks of the given payload size.
+static size_t bin_index_get(size_t size)
+{
+	size_t log = 63u - (size_t)__builtin_clzll(size);
+	size_t bin = ((log - 4u) * BIG_BIN_LOG_STEPS) + ((size >> (log - 3u)) & (BIG_BIN_LOG_STEPS - 1u));
 
+	return ((bin < BIG_BIN_COUNT) ? (bin) : (BIG_BIN_COUNT - 1u));
+}
 
-big_map_header_t *big_zone_start = NULL; // Pointer to the small zone
-big_map_header_t *big_zone_end = NULL; // Pointer to the small zone
+// Returns the smallest payload size of the blocks of a bin.
+static size_t bin_size_min(size_t bin)
+{
+	size_t log = 4u + (bin / BIG_BIN_LOG_STEPS);
 
-static size_t new_map_add(big_map_header_t **new_map, size_t map_size)
+	return (((size_t)1u << log) + ((bin % BIG_BIN_LOG_STEPS) << (log - 3u)));
+}
+
+static void bin_add(big_zone_t *zone, big_block_header_t *block)
 {
-	size_t aligned_size;
+	size_t bin = bin_index_get(BIG_SIZE(block));
+	big_free_links_t *links = BIG_LINKS(block);
 
-	*new_map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
-	(*new_map)-> next = NULL;
-	(*new_map)-> cnt = 1;
-	(*new_map)-> size = map_size;
-	big_zone_end = *new_map;
+	links->prev = NULL;
+	links->next = zone->bins[bin];
+	if (links->next != NULL)
+	{
+		BIG_LINKS(links->next)->prev = block;
+	}
+	zone->bins[bin] = block;
+	zone->bin_bitmap[bin / 64u] |= (uint64_t)1u << (bin % 64u);
+}
 
-	aligned_size = BIG_MAP_HEADER_SIZE / BIG_ALLOC_ALIGMENT;
-	aligned_size = (BIG_MAP_HEADER_SIZE % BIG_ALLOC_ALIGMENT == 0) ? (aligned_size) : (aligned_size + 1);
-	aligned_size *= BIG_ALLOC_ALIGMENT;
-	big_zone_end->first_block = (void *)big_zone_end + aligned_size;
+static void bin_remove(big_zone_t *zone, big_block_header_t *block)
+{
+	size_t bin = bin_index_get(BIG_SIZE(block));
+	big_free_links_t *links = BIG_LINKS(block);
 
-	return (aligned_size);
+	if (links->prev == NULL)
+	{
+		zone->bins[bin] = links->next;
+	}
+	else
+	{
+		BIG_LINKS(links->prev)->next = links->next;
+	}
+	if (links->next != NULL)
+	{
+		BIG_LINKS(links->next)->prev = links->prev;
+	}
+	if (zone->bins[bin] == NULL)
+	{
+		zone->bin_bitmap[bin / 64u] &= ~((uint64_t)1u << (bin % 64u));
+	}
 }
 
-static void *new_map_alloc(size_t size, size_t map_size, size_t free_map_size)
+// Returns the first free block of the first non empty bin whose blocks all fit size, NULL if none.
+static big_block_header_t *bin_find(big_zone_t *zone, size_t size)
 {
-	size_t full_block_size;
-
-	big_zone_end->first_block->used = size;
-	full_block_size = size + BIG_BLOCK_HEADER_SIZE;
-	big_zone_end->first_block->size  = full_block_size / BIG_ALLOC_ALIGMENT;
-	big_zone_end->first_block->size  = (full_block_size % BIG_ALLOC_ALIGMENT == 0) ? (big_zone_end->first_block->size) : (big_zone_end->first_block->size + 1);
-	big_zone_end->first_block->size  *= BIG_ALLOC_ALIGMENT;
-	big_zone_end->first_block->size -= BIG_BLOCK_HEADER_SIZE;
-	if ((free_map_size - big_zone_end->first_block->size) > (2 * BIG_BLOCK_HEADER_SIZE))
-	{
-		big_zone_end->first_block->next = (big_block_header_t *)((uint8_t *)big_zone_end->first_block + big_zone_end->first_block->size + BIG_BLOCK_HEADER_SIZE);
-		big_zone_end->first_block->next->next = NULL;
-		free_map_size -= (big_zone_end->first_block->size + BIG_BLOCK_HEADER_SIZE);
-		big_zone_end->first_block->next->size = free_map_size - BIG_BLOCK_HEADER_SIZE;
-		big_zone_end->first_block->next->used = 0;
+	size_t bin = bin_index_get(size);
+	uint64_t word;
+
+	if (bin_size_min(bin) < size)
+	{
+		bin++; // Some blocks of the bin are too small, start at the next one
+	}
+	while (bin < BIG_BIN_COUNT)
+	{
+		word = zone->bin_bitmap[bin / 64u] & (UINT64_MAX << (bin % 64u));
+		if (word != 0u)
+		{
+			return (zone->bins[((bin / 64u) * 64u) + (size_t)__builtin_ctzll(word)]);
+		}
+		bin = ((bin / 64u) + 1u) * 64u; // Next bitmap word
+	}
+	return (NULL);
+}
+
+
+
+// Maps a new zone, registers its pages and appends it to the map list.
+// Returns the single free block of the map, not binned, NULL if the map could not be created.
+// The block of a new mapping is marked purged: its pages read as zero like the pages of a purged block.
+static big_block_header_t *new_map_add(big_zone_t *zone, size_t map_size, short huge)
+{
+	big_map_header_t *new_map;
+	big_block_header_t *block;
+	big_block_header_t *end_block;
+	short zeroed;
+
+	new_map = MapCache_map(PAGE_MAP_ZONE_BIG, map_size, huge, &zeroed);
+	if (new_map == NULL)
+	{
+		return (NULL);
+	}
+	if (PageMap_register(new_map, map_size, PAGE_MAP_ZONE_BIG, zone->arena_id, new_map) != 0)
+	{
+		MapCache_unmap((void *)new_map, map_size, huge);
+		return (NULL);
+	}
+	new_map->next = NULL;
+	new_map->prev = zone->end;
+	new_map->cnt = 0;
+	new_map->size = map_size;
+	new_map->huge = huge;
+	if (zone->end == NULL)
+	{
+		zone->start = new_map;
 	}
 	else
 	{
-		big_zone_end->first_block->next = NULL;
+		zone->end->next = new_map;
 	}
+	zone->end = new_map;
+
+	end_block = (big_block_header_t *)((uint8_t *)new_map + map_size - BIG_BLOCK_HEADER_SIZE);
+	block = BIG_MAP_FIRST_BLOCK(new_map);
+	block->size = (uint8_t *)end_block - (uint8_t *)block - BIG_BLOCK_HEADER_SIZE;
+	block->used = 0;
+	*BIG_FOOTER(block) = block->size;
+	end_block->size = BIG_BLOCK_USED | BIG_BLOCK_PREV_FREE; // Stops the walk, never merged
+	end_block->used = 0;
+	BIG_LINKS(block)->epoch = (zeroed != 0) ? (BIG_PURGED) : (zone->purge_epoch);
+	return (block);
+}
+
+// Unlinks an empty map from the map list and gives it back to the system.
+// Its free blocks are taken out of the bins, the block being freed is not binned.
+// Free blocks never touch each other, so only the neighbors of the freed block can be free.
+static void map_release(big_zone_t *zone, big_map_header_t *map, big_block_header_t *freed_block)
+{
+	big_block_header_t *next_block = BIG_NEXT(freed_block);
 
-	return ((void *)big_zone_end->first_block + BIG_BLOCK_HEADER_SIZE);
+	if ((next_block->size & BIG_BLOCK_USED) == 0)
+	{
+		bin_remove(zone, next_block);
+	}
+	if ((freed_block->size & BIG_BLOCK_PREV_FREE) != 0)
+	{
+		bin_remove(zone, (big_block_header_t *)((uint8_t *)freed_block - *((size_t *)freed_block - 1) - BIG_BLOCK_HEADER_SIZE));
+	}
+	if (map->prev == NULL)
+	{
+		zone->start = map->next;
+	}
+	else
+	{
+		map->prev->next = map->next;
+	}
+	if (map->next == NULL)
+	{
+		zone->end = map->prev;
+	}
+	else
+	{
+		map->next->prev = map->prev;
+	}
+	PageMap_unregister((void *)map, map->size);
+	MapCache_unmap((void *)map, map->size, map->huge);
 }
 
-static void *old_map_alloc(size_t size)
+// Returns the header of the allocated block ptr points to and the map that holds it, NULL if ptr is not a live block.
+// The header sits right before the payload, the page map tells which map holds it.
+static big_block_header_t *block_get(void *ptr, big_map_header_t **map)
 {
-    big_map_header_t *current_map = big_zone_start;
-    big_block_header_t *current_block, *new_block;
-    size_t full_size, aligned_size, required, diff;
-    void *ret = NULL;
-
-    full_size = size + BIG_BLOCK_HEADER_SIZE;
-    aligned_size = full_size / BIG_ALLOC_ALIGMENT;
-    aligned_size = (full_size % BIG_ALLOC_ALIGMENT == 0) ? aligned_size : (aligned_size + 1);
-    aligned_size *= BIG_ALLOC_ALIGMENT;  // A
-    required = aligned_size - BIG_BLOCK_HEADER_SIZE;  // Needed data size
-
-    while (current_map != NULL)
-    {
-        current_block = current_map->first_block;
-        while (current_block != NULL)
-        {
-            if ((current_block->used == 0) && (current_block->size >= required))
-            {
-                current_block->used = size;
-                diff = current_block->size - required;
-                if (diff > 2 * BIG_BLOCK_HEADER_SIZE)
-                {
-                    new_block = (void *)((uint8_t *)current_block + aligned_size);
-                    new_block->next = current_block->next;
-                    current_block->next = new_block;
-                    new_block->size = diff - BIG_BLOCK_HEADER_SIZE;  // Now correct: (D - A + H) - H = D - A
-                    new_block->used = 0;
-                    current_block->size = required;
-                }
-                ret = (void *)current_block + BIG_BLOCK_HEADER_SIZE;
-                current_map->cnt++;
-                break;
-            }
-            current_block = current_block->next;
-        }
-        if (ret != NULL)
-        {
-            break;
-        }
-        current_map = current_map->next;
-    }
-    return (ret);
+	big_block_header_t *block = (big_block_header_t *)((uint8_t *)ptr - BIG_BLOCK_HEADER_SIZE);
+
+	*map = PageMap_owner_get(ptr, PAGE_MAP_ZONE_BIG);
+	if ((*map == NULL) || (((uintptr_t)ptr % BIG_ALLOC_ALIGMENT) != 0) || (block < BIG_MAP_FIRST_BLOCK(*map)))
+	{
+		return (NULL); // Not a big zone pointer
+	}
+	if (((block->size & BIG_BLOCK_USED) == 0) || (BIG_SIZE(block) == 0))
+	{
+		return (NULL); // Free block or end of the map
+	}
+	return (block);
+}
+
+// Returns the payload size of a block that holds size bytes.
+static size_t block_size_get(size_t size)
+{
+	size_t full_size = size + BIG_BLOCK_HEADER_SIZE;
+	size_t aligned_size = full_size / BIG_ALLOC_ALIGMENT;
+
+	aligned_size = (full_size % BIG_ALLOC_ALIGMENT == 0) ? (aligned_size) : (aligned_size + 1);
+	aligned_size *= BIG_ALLOC_ALIGMENT;
+	aligned_size -= BIG_BLOCK_HEADER_SIZE;
+	return ((aligned_size < BIG_BLOCK_SIZE_MIN) ? (BIG_BLOCK_SIZE_MIN) : (aligned_size));
+}
+
+// Marks a free block as free: writes its footer and tells the next block.
+static void block_free_set(big_block_header_t *block)
+{
+	block->size &= ~BIG_BLOCK_USED;
+	*BIG_FOOTER(block) = BIG_SIZE(block);
+	BIG_NEXT(block)->size |= BIG_BLOCK_PREV_FREE;
+}
+
+// Returns in start and end the whole pages between the links and the footer of a free block,
+// the pages a purge gives back. In a huge page map only whole huge pages count. start >= end if there is none.
+static void block_purge_range(big_block_header_t *block, uintptr_t *start, uintptr_t *end)
+{
+	const big_map_header_t *map = PageMap_owner_get(block, PAGE_MAP_ZONE_BIG);
+	const uintptr_t page_size = (map->huge != 0) ? ((uintptr_t)MAP_CACHE_HUGE_PAGE_SIZE) : ((uintptr_t)sysconf(_SC_PAGESIZE)); // Get the page size
+
+	*start = ((uintptr_t)(BIG_LINKS(block) + 1) + page_size - 1u) & ~(page_size - 1u);
+	*end = (uintptr_t)BIG_FOOTER(block) & ~(page_size - 1u);
 }
 
+// Cuts the tail of a block being allocated past required into a new free block if it is large enough to be one.
+// The new block gets the epoch of the free block its pages come from, they are neither older nor newer.
+static void block_split(big_zone_t *zone, big_block_header_t *block, size_t required, size_t epoch)
+{
+	big_block_header_t *new_block;
+
+	if (BIG_SIZE(block) >= required + BIG_BLOCK_HEADER_SIZE + BIG_BLOCK_SIZE_MIN)
+	{
+		new_block = (big_block_header_t *)((uint8_t *)block + BIG_BLOCK_HEADER_SIZE + required);
+		new_block->size = BIG_SIZE(block) - required - BIG_BLOCK_HEADER_SIZE;
+		new_block->used = 0;
+		block->size = required | (block->size & BIG_BLOCK_FLAGS);
+		block_free_set(new_block);
+		bin_add(zone, new_block);
+		BIG_LINKS(new_block)->epoch = epoch;
+	}
+}
+
+// Turns a free block that is out of the bins into an allocated block of size bytes.
+// With zero set the payload is cleared, except the pages of a purged block: they still read as zero.
+static void *block_take(big_zone_t *zone, big_map_header_t *map, big_block_header_t *block, size_t size, short zero)
+{
+	uint8_t *payload = (uint8_t *)block + BIG_BLOCK_HEADER_SIZE;
+	uintptr_t zero_start = (uintptr_t)payload + size;
+	uintptr_t zero_end = (uintptr_t)payload + size;
+
+	if ((zero != 0) && (BIG_LINKS(block)->epoch == BIG_PURGED))
+	{
+		block_purge_range(block, &zero_start, &zero_end); // Read before the split writes the footer of the tail
+		zero_end = (zero_end < (uintptr_t)payload + size) ? (zero_end) : ((uintptr_t)payload + size);
+		zero_start = (zero_start < zero_end) ? (zero_start) : ((uintptr_t)payload + size);
+		zero_end = (zero_start < zero_end) ? (zero_end) : ((uintptr_t)payload + size);
+	}
+	block_split(zone, block, block_size_get(size), BIG_LINKS(block)->epoch);
+	block->size |= BIG_BLOCK_USED;
+	block->used = size;
+	BIG_NEXT(block)->size &= ~BIG_BLOCK_PREV_FREE;
+	map->cnt++;
+	if (zero != 0)
+	{
+		memset(payload, 0, zero_start - (uintptr_t)payload); // Head page, holds the links
+		memset((void *)zero_end, 0, (uintptr_t)payload + size - zero_end); // Tail page, holds the footer
+	}
+	return ((void *)payload);
+}
 
-// Allocates a block of memory of the given size.
-void *ZoneAllocatorBig_alloc(size_t size)
+// Moves the payload of a free block that is out of the bins up to the next multiple of align.
+// The leading slack becomes a free block of its own, binned with the epoch of the block.
+// If the slack is too small to be a block the payload moves one more align further,
+// the caller sized the block for it. Returns the block holding the aligned payload, not binned.
+static big_block_header_t *block_align(big_zone_t *zone, big_block_header_t *block, size_t align)
 {
-    big_map_header_t *start_header;
-	const int page_size = sysconf(_SC_PAGESIZE) ; // Get the page size
-	const size_t full_size = size + BIG_BLOCK_HEADER_SIZE + BIG_MAP_HEADER_SIZE;
-	size_t aligned_size, map_size = 0;
-	void * ret = NULL;
+	const uintptr_t payload = (uintptr_t)block + BIG_BLOCK_HEADER_SIZE;
+	uintptr_t aligned = (payload + align - 1u) & ~(uintptr_t)(align - 1u);
+	big_block_header_t *aligned_block;
+
+	if (aligned == payload)
+	{
+		return (block);
+	}
+	if (aligned - payload < BIG_BLOCK_HEADER_SIZE + BIG_BLOCK_SIZE_MIN)
+	{
+		aligned += align; // Room for the header and the links of the slack block
+	}
+	aligned_block = (big_block_header_t *)(aligned - BIG_BLOCK_HEADER_SIZE);
+	aligned_block->size = (BIG_SIZE(block) - (aligned - payload)) | BIG_BLOCK_PREV_FREE;
+	aligned_block->used = 0;
+	BIG_LINKS(aligned_block)->epoch = BIG_LINKS(block)->epoch;
+	block->size = (aligned - payload - BIG_BLOCK_HEADER_SIZE) | (block->size & BIG_BLOCK_FLAGS);
+	block_free_set(block);
+	bin_add(zone, block);
+	return (aligned_block);
+}
+
+// Allocates a block of memory of the given size whose payload is a multiple of align, cleared if zero is set.
+// The block is taken from the bins, a new map is created if none fits.
+// A block for an alignment above 16 is searched with room for the slack cut off in front of the payload.
+// In huge page mode maps are made of huge pages, the shared ones are one huge page.
+static void *block_alloc(big_zone_t *zone, size_t size, size_t align, short zero)
+{
+	const short huge = MapCache_huge_get();
+	const size_t page_size = (huge != 0) ? (MAP_CACHE_HUGE_PAGE_SIZE) : ((size_t)sysconf(_SC_PAGESIZE)); // Get the page size
+	const size_t map_min = (huge != 0) ? (MAP_CACHE_HUGE_PAGE_SIZE / 2u) : (BIG_MAP_MIN_ALLOC * page_size); // Blocks past it get a map of their own
+	const size_t slack = (align > BIG_ALLOC_ALIGMENT) ? (align + BIG_BLOCK_HEADER_SIZE + BIG_BLOCK_SIZE_MIN) : (0); // Worst slack in front of an aligned payload
+	const size_t full_size = block_size_get(size) + slack + (2 * BIG_BLOCK_HEADER_SIZE) + BIG_MAP_HEADER_ALIGNED; // Block, end of the map and map header
+	size_t map_size = 0;
+	big_block_header_t *block = NULL;
 
 	if (size == 0)
 	{
-		return (ret);
+		return (NULL);
 	}
 
-	if (full_size > (BIG_MAP_MIN_ALLOC * page_size))
+	if (full_size > map_min)
 	{
 		map_size = full_size / page_size;
 		map_size = ((full_size % page_size) == 0) ? (map_size) : (map_size + 1);
@@ -147,320 +367,268 @@ void *ZoneAllocatorBig_alloc(size_t size)
 	}
 	else
 	{
-		ret = old_map_alloc(size);
-		if (ret == NULL)
+		block = bin_find(zone, block_size_get(size) + slack);
+		if (block != NULL)
 		{
-			map_size = BIG_MAP_DEFAULT_ALLOC * page_size;
+			bin_remove(zone, block);
+			block = (slack != 0) ? (block_align(zone, block, align)) : (block);
+			return (block_take(zone, PageMap_owner_get(block, PAGE_MAP_ZONE_BIG), block, size, zero));
 		}
+		map_size = (huge != 0) ? (MAP_CACHE_HUGE_PAGE_SIZE) : (BIG_MAP_DEFAULT_ALLOC * page_size);
 	}
-	
-	if (map_size != 0)
+
+	block = new_map_add(zone, map_size, huge);
+	if (block == NULL)
 	{
-		if (big_zone_start == NULL) 
-		{
-			aligned_size = new_map_add(&big_zone_start, map_size);
-		}
-		else
-		{
-			aligned_size = new_map_add(&(big_zone_end->next), map_size);
-		}
-		ret = new_map_alloc(size, map_size, map_size - aligned_size);	
+		return (NULL);
 	}
+	block = (slack != 0) ? (block_align(zone, block, align)) : (block);
+	return (block_take(zone, zone->end, block, size, zero));
+}
 
-    return (ret);
+void *ZoneAllocatorBig_alloc(big_zone_t *zone, size_t size)
+{
+	return (block_alloc(zone, size, BIG_ALLOC_ALIGMENT, 0));
 }
 
-size_t ZoneAllocatorBig_size_get(void *ptr)
+// Allocates a block of size bytes whose payload is a multiple of align, a power of two.
+// The slack in front of the payload is split off as a free block and serves later requests.
+void *ZoneAllocatorBig_aligned_alloc(big_zone_t *zone, size_t size, size_t align)
 {
-    size_t ret = 0;
+	return (block_alloc(zone, size, align, 0));
+}
 
-    if (ptr == NULL)
-    {
-        ret = 0; // Invalid pointer
-    }
-    else
-    {
-		big_map_header_t *current_map = big_zone_start;
-		big_block_header_t *current_block;
+// Allocates a block of size bytes that reads as zero.
+// Only the bytes that may hold old data are written: a block cut from a new map or from purged pages
+// gets its first and last page cleared, the pages in between are left to fault in as zero pages.
+void *ZoneAllocatorBig_calloc(big_zone_t *zone, size_t size)
+{
+	return (block_alloc(zone, size, BIG_ALLOC_ALIGMENT, 1));
+}
 
-		while (current_map != NULL)
-		{
-			current_block = current_map->first_block;
-			while (current_block != NULL)
-			{
-				if (((void *)current_block + BIG_BLOCK_HEADER_SIZE) == ptr)
-				{
-					ret = current_block->used;
-					break;
-				}
-				current_block = current_block->next;
-			}
-			if (ret != 0)
-			{
-				break;
-			}
-			current_map = current_map->next;
-		}
-    }
-    return (ret);
+size_t ZoneAllocatorBig_size_get(void *ptr)
+{
+	big_map_header_t *current_map;
+	big_block_header_t *current_block;
+
+	if (ptr == NULL)
+	{
+		return (0); // Invalid pointer
+	}
+	current_block = block_get(ptr, &current_map);
+	return ((current_block == NULL) ? (0) : (current_block->used));
 }
 
-static void defrag(big_block_header_t* prev_block, big_block_header_t *block)
+// Returns the payload size of the allocated block ptr, the block can grow up to it in place.
+// Returns 0 if ptr is not a live big block. The arena lock must be held, the size word also carries the flag of the previous block.
+size_t ZoneAllocatorBig_capacity_get(void *ptr)
 {
-	if (block != NULL)
+	big_map_header_t *current_map;
+	big_block_header_t *current_block;
+
+	if (ptr == NULL)
 	{
-		big_block_header_t* next_block = block->next;
-		size_t size = block->size;
-		big_block_header_t* temp_block = block->next;
+		return (0);
+	}
+	current_block = block_get(ptr, &current_map);
+	return ((current_block == NULL) ? (0) : (BIG_SIZE(current_block)));
+}
 
-		if (next_block != NULL)
-		{
-			if (next_block->used == 0)
-			{
-				size += next_block->size;
-				size += BIG_BLOCK_HEADER_SIZE;
-				temp_block = next_block->next;
-			}
-		}
-		if (prev_block != NULL)
-		{
-			if (prev_block->used == 0);
-			{
-				size += prev_block->size;
-				size += BIG_BLOCK_HEADER_SIZE;
-				prev_block->size = size;
-				prev_block->next = temp_block;
-				return;
-			}
-		}
-		block->size = size;
-		block->next = temp_block;
-		return;
+// Records a new used size for an allocated block that fits its payload.
+// The arena lock must be held, the report reads the used size of every block of the zone.
+void ZoneAllocatorBig_used_set(void *ptr, size_t size)
+{
+	big_block_header_t *header = (big_block_header_t *)((uint8_t *)ptr - BIG_BLOCK_HEADER_SIZE);
+
+	if ((size != 0u) && (size <= BIG_SIZE(header)))
+	{
+		header->used = size;
 	}
+}
 
+// Merges a freed block with its free neighbors and puts the result in its bin.
+static void defrag(big_zone_t *zone, big_block_header_t *block)
+{
+	big_block_header_t* next_block = BIG_NEXT(block);
+	big_block_header_t* prev_block;
+
+	if ((next_block->size & BIG_BLOCK_USED) == 0)
+	{
+		bin_remove(zone, next_block);
+		block->size += BIG_BLOCK_HEADER_SIZE + BIG_SIZE(next_block);
+	}
+	if ((block->size & BIG_BLOCK_PREV_FREE) != 0)
+	{
+		prev_block = (big_block_header_t *)((uint8_t *)block - *((size_t *)block - 1) - BIG_BLOCK_HEADER_SIZE);
+		bin_remove(zone, prev_block);
+		prev_block->size += BIG_BLOCK_HEADER_SIZE + BIG_SIZE(block);
+		block = prev_block;
+	}
+	block_free_set(block);
+	bin_add(zone, block);
+	BIG_LINKS(block)->epoch = zone->purge_epoch; // Dirty, even if merged with purged neighbors
 }
 
 // Frees the memory block pointed to by ptr.
-short ZoneAllocatorBig_free(void *ptr)
+// An empty map is given back to the system.
+short ZoneAllocatorBig_free(big_zone_t *zone, void *ptr)
 {
-    short ret = 0;
-    if (ptr == NULL)
-    {
-        ret = -1; // Invalid pointer
-    }
+	big_map_header_t *current_map;
+	big_block_header_t *current_block;
+
+	if (ptr == NULL)
+	{
+		return (-1); // Invalid pointer
+	}
+	current_block = block_get(ptr, &current_map);
+	if (current_block == NULL)
+	{
+		return (-2); //Not found
+	}
+	current_block->used = 0; //Freed
+	current_map->cnt--;
+	if(current_map->cnt == 0)
+	{
+		map_release(zone, current_map, current_block);
+	}
 	else
-    {
-		big_map_header_t *current_map = big_zone_start;
-		big_map_header_t *prev_map = NULL;
-		big_block_header_t *current_block, *prev_block;
+	{
+		defrag(zone, current_block);
+	}
+	return (0);
+}
 
-		while (current_map != NULL)
-		{
-			prev_block = NULL;
-			current_block = current_map->first_block;
-			while (current_block != NULL)
-			{
-				if (((void *)current_block + BIG_BLOCK_HEADER_SIZE) == ptr)
-				{
-					current_block->used = 0; //Freed
-					current_map->cnt--;
-					if(current_map->cnt == 0)
-					{	
-						if (prev_map == NULL)
-						{
-							big_zone_start = current_map->next;
-						}
-						else
-						{
-							prev_map->next = current_map->next;
-						}
-						if (current_map->next == NULL)
-						{
-							big_zone_end = prev_map;
-						}
-						munmap((void *)current_map, current_map->size);
-					}
-					else
-					{
-						defrag(prev_block, current_block);
-					}
-					break;
-				}
-				prev_block = current_block;
-				current_block = current_block->next;
-			}
-			if (current_block != NULL)
-			{
-				break;
-			}
-			prev_map = current_map;
-			current_map = current_map->next;
-		}
-		if (current_map == NULL)
-		{
-			ret = -2; //Not found
-		}
-    }
-    return (ret);
+// This function only performs an in place realocation if the pointer is valid.
+// It grows the block into the following free block when possible.
+// It returns ptr on success, otherwise NULL and the block is left untouched so the caller can move it.
+void *ZoneAllocatorBig_realloc(big_zone_t *zone, void *ptr, size_t size)
+{
+	big_map_header_t *current_map;
+	big_block_header_t *current_block, *next_block;
+	size_t required;
+
+	if ((ptr == NULL) || (size == 0))
+	{
+		return (NULL); // Invalid pointer or size
+	}
+	current_block = block_get(ptr, &current_map);
+	if (current_block == NULL)
+	{
+		return (NULL); // Not found
+	}
+	if (BIG_SIZE(current_block) >= size)
+	{
+		current_block->used = size;
+		return (ptr);
+	}
+	required = block_size_get(size);
+	next_block = BIG_NEXT(current_block);
+	if (((next_block->size & BIG_BLOCK_USED) != 0)
+		|| (BIG_SIZE(current_block) + BIG_SIZE(next_block) + BIG_BLOCK_HEADER_SIZE < required))
+	{
+		return (NULL); // The next block can not make room
+	}
+	bin_remove(zone, next_block);
+	current_block->size += BIG_SIZE(next_block) + BIG_BLOCK_HEADER_SIZE; // Take the whole free block
+	block_split(zone, current_block, required, BIG_LINKS(next_block)->epoch); // Give back what is not needed
+	BIG_NEXT(current_block)->size &= ~BIG_BLOCK_PREV_FREE;
+	current_block->used = size;
+	return (ptr);
 }
 
-// This function only performs a realocation if the pointer is valid and the size is valid for the small zone.
-// It checks if the pointer is in the small zone.
-void *ZoneAllocatorBig_realloc(void *ptr, size_t size)
+// Gives back to the system the whole pages between the links and the footer of a free block, they read as zero once touched again.
+// In a huge page map only whole huge pages are released.
+// Pages that fit the slack left in pad are kept dirty and taken from it.
+// Returns the number of bytes released.
+static size_t block_purge(big_block_header_t *block, size_t *pad)
 {
-	void *ret = ptr;
+	uintptr_t start;
+	uintptr_t end;
 
-	if (ptr == NULL)
+	block_purge_range(block, &start, &end);
+	if ((start < end) && (end - start <= *pad))
 	{
-		ret = NULL; // Invalid pointer
+		*pad -= end - start; // Kept as slack
+		return (0);
 	}
-	else if (size == 0)
+	if (start >= end)
 	{
-		ZoneAllocatorBig_free(ptr);
-		ret = NULL; // Invalid size
+		BIG_LINKS(block)->epoch = BIG_PURGED; // No whole page inside the block, an allocation clears all of it anyway
+		return (0);
 	}
-	else
+	if (madvise((void *)start, end - start, MADV_DONTNEED) != 0)
 	{
-		big_map_header_t *current_map = big_zone_start;
-		big_map_header_t *prev_map = NULL;
-		big_block_header_t *current_block, *prev_block;
+		return (0); // Pages kept, the block stays dirty and is tried again on the next purge
+	}
+	BIG_LINKS(block)->epoch = BIG_PURGED; // Only now its pages read as zero
+	return (end - start);
+}
 
-		while (current_map != NULL)
+// Gives back to the system the pages of the free blocks freed before the last purge tick, then starts a new tick.
+// Returns the number of bytes released.
+size_t ZoneAllocatorBig_purge(big_zone_t *zone)
+{
+	big_block_header_t *block;
+	size_t purged = 0;
+	size_t pad = 0;
+
+	for (size_t bin = 0; bin < BIG_BIN_COUNT; bin++)
+	{
+		for (block = zone->bins[bin]; block != NULL; block = BIG_LINKS(block)->next)
 		{
-			prev_block = NULL;
-			current_block = current_map->first_block;
-			while (current_block != NULL)
+			if (BIG_LINKS(block)->epoch < zone->purge_epoch) // Not purged yet and not freed during this tick
 			{
-				if (((void *)current_block + BIG_BLOCK_HEADER_SIZE) == ptr)
-				{
-					size_t aligned_size = (size + BIG_BLOCK_HEADER_SIZE) / BIG_ALLOC_ALIGMENT; // Calculate the aligned size
-					aligned_size = aligned_size * BIG_ALLOC_ALIGMENT; // Align the size
-					aligned_size += (aligned_size % BIG_ALLOC_ALIGMENT == 0u) ? (0u) : (BIG_ALLOC_ALIGMENT); // Align to 16
-					big_block_header_t* next_block = current_block->next;
-					if (current_block->size < size)
-					{
-						if ((next_block != NULL)) 
-						{
-							size_t max_size = current_block->size + next_block->size + 2 * BIG_BLOCK_HEADER_SIZE;
-							if (max_size > aligned_size)
-							{
-								current_block->used = size;
-								size_t size_diff = max_size  - aligned_size;
-								if (size_diff > (2 * BIG_BLOCK_HEADER_SIZE))
-								{
-									current_block->next = (void *)((uint8_t *)current_block + aligned_size);
-									current_block->next->next = next_block->next;
-									current_block->next->used = 0;
-									current_block->next->size = size_diff - BIG_BLOCK_HEADER_SIZE;
-								}
-								else
-								{
-									current_block->next = next_block->next;
-								}
-								
-								current_block->size = aligned_size - BIG_BLOCK_HEADER_SIZE;
-							}
-							else
-							{
-								current_block->used = 0; //Freed
-								current_map->cnt--;
-								if(current_map->cnt == 0)
-								{
-									if (prev_map == NULL)
-									{
-										big_zone_start = current_map->next;
-									}
-									else
-									{
-										prev_map->next = current_map->next;
-									}
-									if (current_map->next == NULL)
-									{
-										big_zone_end = prev_map;
-									}
-									munmap((void *)current_map, current_map->size);
-								}
-								else
-								{
-									defrag(prev_block, current_block);
-								}
-								ret = ZoneAllocatorBig_alloc(size);
-							}
-
-						}
-						else
-						{
-							current_block->used = 0; //Freed
-							current_map->cnt--;
-							if(current_map->cnt == 0)
-							{
-								if (prev_map == NULL)
-								{
-									big_zone_start = current_map->next;
-								}
-								else
-								{
-									prev_map->next = current_map->next;
-								}
-								if (current_map->next == NULL)
-								{
-									big_zone_end = prev_map;
-								}
-								munmap((void *)current_map, current_map->size);
-							}
-							else
-							{
-								defrag(prev_block, current_block);
-							}
-							ret = ZoneAllocatorBig_alloc(size);
-						}
-					}
-					else
-					{
-						current_block->used = size;
-					}
-					break;
-				}
-				prev_block = current_block;
-				current_block = current_block->next;
+				purged += block_purge(block, &pad);
 			}
-			if (current_block != NULL)
-			{
-				break;
-			}
-			prev_map = current_map;
-			current_map = current_map->next;
 		}
-		if (current_block == NULL)
+	}
+	zone->purge_epoch++;
+	return (purged);
+}
+
+// Gives back the pages of every free block whatever its age, the pages that fit the slack left in pad are kept.
+// Maps are released as soon as they are empty, so only the free blocks are walked.
+// Returns the number of bytes released.
+size_t ZoneAllocatorBig_trim(big_zone_t *zone, size_t *pad)
+{
+	big_block_header_t *block;
+	size_t released = 0;
+
+	for (size_t bin = 0; bin < BIG_BIN_COUNT; bin++)
+	{
+		for (block = zone->bins[bin]; block != NULL; block = BIG_LINKS(block)->next)
 		{
-			ret = ZoneAllocatorBig_alloc(size);
+			if (BIG_LINKS(block)->epoch != BIG_PURGED)
+			{
+				released += block_purge(block, pad);
+			}
 		}
-    }
-	return ret;
+	}
+	return (released);
 }
 
 
 // This function prints the memory map of the big zone.
 // It prints the start address, end address, and size of each block.
 // It also prints the start address of each map.
-void ZoneAllocatorBig_report(void)
+void ZoneAllocatorBig_report(big_zone_t *zone)
 {
-    if (big_zone_start == NULL)
+    if (zone->start == NULL)
     {
         return;
     }
     write (1, "BIG : ", 6);
-	big_map_header_t *current_map = big_zone_start;
+	big_map_header_t *current_map = zone->start;
 	big_block_header_t *current_block;
 	while  (current_map != NULL)
 	{
 		print_address_as_hex((void *)current_map); // Print the start address of map
 		write (1, "\n", 1);
 
-		current_block = current_map->first_block; // Set the current block
-		while (current_block != NULL)
+		current_block = BIG_MAP_FIRST_BLOCK(current_map); // Set the current block
+		while (BIG_SIZE(current_block) != 0)
 		{
-			if (current_block->used != 0u)
+			if ((current_block->size & BIG_BLOCK_USED) != 0u)
 			{
 				print_address_as_hex((void *)((uint8_t *)current_block + BIG_BLOCK_HEADER_SIZE)); //Print the address of the block
 				write (1, " - ", 3);
@@ -469,7 +637,7 @@ void ZoneAllocatorBig_report(void)
 				print_size(current_block->used); // Print the size of the block
 				write (1, "\n", 1);
 			}
-			current_block = current_block->next; // Move to the next block
+			current_block = BIG_NEXT(current_block); // Move to the next block
 		}
 		write (1, "\n", 1);
 		current_map = current_map->next;
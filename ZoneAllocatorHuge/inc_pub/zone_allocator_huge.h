@@ -0,0 +1,24 @@
+#ifndef IG_ZONE_ALLOCATOR_HUGE_H
+#define IG_ZONE_ALLOCATOR_HUGE_H
+
+#include <stdlib.h>
+#include <inttypes.h>
+
+#define HUGE_THRESHOLD_DEFAULT (size_t)(128u * 1024u) // Requests from this size on get their own mapping
+#define HUGE_THRESHOLD_MIN (size_t)(64u * 1024u) // Lowest accepted threshold, below it the big zone is a better fit
+
+void *ZoneAllocatorHuge_alloc(size_t size);
+void *ZoneAllocatorHuge_aligned_alloc(size_t size, size_t align);
+short ZoneAllocatorHuge_free(void *ptr);
+void *ZoneAllocatorHuge_realloc(void *ptr, size_t size);
+
+size_t ZoneAllocatorHuge_size_get(void *ptr);
+size_t ZoneAllocatorHuge_capacity_get(void *ptr);
+size_t ZoneAllocatorHuge_threshold_get(void);
+short ZoneAllocatorHuge_threshold_set(size_t threshold);
+void ZoneAllocatorHuge_report(void);
+void ZoneAllocatorHuge_fork_lock(void);
+void ZoneAllocatorHuge_fork_unlock(void);
+
+
+#endif // IG_ZONE_ALLOCATOR_HUGE_H
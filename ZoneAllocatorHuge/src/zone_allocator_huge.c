@@ -0,0 +1,333 @@
+#define _GNU_SOURCE // mremap
+#include "../inc_pub/zone_allocator_huge.h"
+#include "../../print_utils/inc_pub/print_utils.h"
+#include <sys/mman.h>
+#include <pthread.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+// Huge blocks are one mapping each, the payload is the start of the mapping.
+// They are not registered in the page map (that would cost one entry per page),
+// an open addressing hash table keyed by the mapping address tracks them instead.
+// The table is shared by every arena behind its own lock, the mmap, mremap and munmap calls are made outside of it.
+// Realloc resizes the mapping with mremap, the kernel moves the pages instead of copying them.
+
+#define HUGE_TABLE_SIZE_MIN 256u // Slots of the first table, power of two
+#define HUGE_SLOT_EMPTY (uintptr_t)0u // Slot never used
+#define HUGE_SLOT_DELETED (uintptr_t)1u // Slot of a freed block, searches go on past it
+#define HUGE_HASH_MULTIPLIER (uintptr_t)0x9E3779B97F4A7C15u // Fibonacci hashing
+
+typedef struct
+{
+    uintptr_t start; // Address of the mapping, HUGE_SLOT_EMPTY or HUGE_SLOT_DELETED
+    size_t mapped_size; // Used for munmap
+    size_t used; // Used size of the block
+} huge_entry_t;
+
+huge_entry_t *huge_table = NULL; // Slots of the hash table
+size_t huge_table_size = 0u; // Number of slots, power of two
+size_t huge_table_shift = 0u; // 64 - log2(huge_table_size), keeps the high bits of the hash
+size_t huge_table_cnt = 0u; // Live blocks in the table
+size_t huge_table_deleted = 0u; // Deleted slots in the table
+size_t huge_threshold = HUGE_THRESHOLD_DEFAULT; // Requests from this size on are huge
+pthread_mutex_t huge_lock = PTHREAD_MUTEX_INITIALIZER; // Protects the table
+
+// Returns the slot where the search for start begins.
+static size_t slot_first(uintptr_t start)
+{
+    return ((size_t)(((start >> 12u) * HUGE_HASH_MULTIPLIER) >> huge_table_shift));
+}
+
+// Returns the slot holding start, or the table size if start is not in the table.
+static size_t slot_find(uintptr_t start)
+{
+    size_t slot;
+
+    if (huge_table == NULL)
+    {
+        return (huge_table_size);
+    }
+    slot = slot_first(start);
+    while (huge_table[slot].start != HUGE_SLOT_EMPTY)
+    {
+        if (huge_table[slot].start == start)
+        {
+            return (slot);
+        }
+        slot = (slot + 1u) & (huge_table_size - 1u);
+    }
+    return (huge_table_size);
+}
+
+// Stores an entry in the first empty or deleted slot of its probe sequence.
+static void slot_insert(huge_entry_t *entry)
+{
+    size_t slot = slot_first(entry->start);
+
+    while (huge_table[slot].start > HUGE_SLOT_DELETED)
+    {
+        slot = (slot + 1u) & (huge_table_size - 1u);
+    }
+    if (huge_table[slot].start == HUGE_SLOT_DELETED)
+    {
+        huge_table_deleted--;
+    }
+    huge_table[slot] = *entry;
+    huge_table_cnt++;
+}
+
+// Makes room for one more entry, rebuilding the table when it would be more than half full.
+// Deleted slots are dropped by the rebuild.
+// Returns 0 on success, -1 if the new table could not be mapped.
+static short table_reserve(void)
+{
+    huge_entry_t *old_table = huge_table;
+    size_t old_size = huge_table_size;
+    size_t new_size = HUGE_TABLE_SIZE_MIN;
+    huge_entry_t *new_table;
+
+    if ((huge_table != NULL) && ((huge_table_cnt + huge_table_deleted + 1u) * 2u <= huge_table_size))
+    {
+        return (0);
+    }
+    while (new_size < (huge_table_cnt + 1u) * 4u)
+    {
+        new_size *= 2u;
+    }
+    new_table = mmap(NULL, new_size * sizeof(huge_entry_t), PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (new_table == MAP_FAILED)
+    {
+        return (-1);
+    }
+    huge_table = new_table;
+    huge_table_size = new_size;
+    huge_table_shift = 64u - (size_t)__builtin_ctzll(new_size);
+    huge_table_cnt = 0u;
+    huge_table_deleted = 0u;
+    for (size_t i = 0u; i < old_size; i++)
+    {
+        if (old_table[i].start > HUGE_SLOT_DELETED)
+        {
+            slot_insert(&old_table[i]);
+        }
+    }
+    if (old_table != NULL)
+    {
+        munmap((void *)old_table, old_size * sizeof(huge_entry_t));
+    }
+    return (0);
+}
+
+// Maps a block of its own for size bytes and records it in the table.
+void *ZoneAllocatorHuge_alloc(size_t size)
+{
+    return (ZoneAllocatorHuge_aligned_alloc(size, 0u));
+}
+
+// Maps a block of its own for size bytes starting on a multiple of align and records it in the table.
+// An alignment up to the page size is free, a larger one maps align bytes more and unmaps the slack around the block.
+// align must be 0 or a power of two.
+void *ZoneAllocatorHuge_aligned_alloc(size_t size, size_t align)
+{
+    const size_t page_size = (size_t)sysconf(_SC_PAGESIZE); // Get the page size
+    size_t slack = (align > page_size) ? (align - page_size) : (0u); // Extra bytes mapped to find an aligned start
+    huge_entry_t entry;
+    uintptr_t start;
+    void *map;
+
+    if ((size == 0u) || (size > SIZE_MAX - page_size - slack))
+    {
+        return (NULL); // Invalid size
+    }
+    entry.mapped_size = ((size + page_size - 1u) / page_size) * page_size; // Align to page size
+    entry.used = size;
+    map = mmap(NULL, entry.mapped_size + slack, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (map == MAP_FAILED)
+    {
+        return (NULL); // Allocation failed
+    }
+    start = (uintptr_t)map;
+    if (slack != 0u)
+    {
+        start = (start + align - 1u) & ~(uintptr_t)(align - 1u);
+        if (start != (uintptr_t)map)
+        {
+            munmap(map, start - (uintptr_t)map); // Leading slack
+        }
+        if ((uintptr_t)map + slack != start)
+        {
+            munmap((void *)(start + entry.mapped_size), (uintptr_t)map + slack - start); // Trailing slack
+        }
+        map = (void *)start;
+    }
+    entry.start = start;
+    pthread_mutex_lock(&huge_lock);
+    if (table_reserve() != 0)
+    {
+        pthread_mutex_unlock(&huge_lock);
+        munmap(map, entry.mapped_size);
+        return (NULL); // Block could not be recorded
+    }
+    slot_insert(&entry);
+    pthread_mutex_unlock(&huge_lock);
+    return (map);
+}
+
+// Frees the huge block pointed to by ptr.
+// Returns 0 on success, -2 if ptr is not a huge block.
+short ZoneAllocatorHuge_free(void *ptr)
+{
+    size_t slot;
+    size_t mapped_size;
+
+    pthread_mutex_lock(&huge_lock);
+    slot = slot_find((uintptr_t)ptr);
+    if (slot == huge_table_size)
+    {
+        pthread_mutex_unlock(&huge_lock);
+        return (-2); // Not found
+    }
+    mapped_size = huge_table[slot].mapped_size;
+    huge_table[slot].start = HUGE_SLOT_DELETED;
+    huge_table_cnt--;
+    huge_table_deleted++;
+    pthread_mutex_unlock(&huge_lock);
+    munmap(ptr, mapped_size);
+    return (0);
+}
+
+// Resizes the huge block pointed to by ptr with mremap, the block may move.
+// Growing past the mapping extends it, shrinking by at least one page gives the tail back.
+// It returns the block on success, otherwise NULL and the block is left untouched so the caller can move it.
+void *ZoneAllocatorHuge_realloc(void *ptr, size_t size)
+{
+    const size_t page_size = (size_t)sysconf(_SC_PAGESIZE); // Get the page size
+    huge_entry_t entry;
+    size_t new_size;
+    size_t slot;
+    void *map;
+
+    if ((ptr == NULL) || (size == 0u) || (size > SIZE_MAX - page_size))
+    {
+        return (NULL); // Invalid pointer or size
+    }
+    // The entry leaves the table while the mapping is resized: once the old range is unmapped
+    // another thread may map it again and record it under the same address
+    pthread_mutex_lock(&huge_lock);
+    slot = slot_find((uintptr_t)ptr);
+    if (slot == huge_table_size)
+    {
+        pthread_mutex_unlock(&huge_lock);
+        return (NULL); // Not found
+    }
+    entry = huge_table[slot];
+    huge_table[slot].start = HUGE_SLOT_DELETED;
+    huge_table_cnt--;
+    huge_table_deleted++;
+    pthread_mutex_unlock(&huge_lock);
+
+    new_size = ((size + page_size - 1u) / page_size) * page_size; // Align to page size
+    map = ptr;
+    if (new_size != entry.mapped_size)
+    {
+        map = mremap(ptr, entry.mapped_size, new_size, MREMAP_MAYMOVE);
+    }
+    if (map != MAP_FAILED)
+    {
+        entry.start = (uintptr_t)map;
+        entry.mapped_size = new_size;
+        entry.used = size;
+    }
+
+    pthread_mutex_lock(&huge_lock);
+    table_reserve(); // Drops the deleted slots if needed, the removal above left room for the entry anyway
+    slot_insert(&entry);
+    pthread_mutex_unlock(&huge_lock);
+    return ((map == MAP_FAILED) ? (NULL) : (map)); // On failure the old mapping is still valid
+}
+
+// Returns the used size of the huge block pointed to by ptr, 0 if ptr is not a huge block.
+size_t ZoneAllocatorHuge_size_get(void *ptr)
+{
+    size_t ret = 0u;
+    size_t slot;
+
+    pthread_mutex_lock(&huge_lock);
+    slot = slot_find((uintptr_t)ptr);
+    if (slot != huge_table_size)
+    {
+        ret = huge_table[slot].used;
+    }
+    pthread_mutex_unlock(&huge_lock);
+    return (ret);
+}
+
+// Takes the table lock so a fork cannot copy it held, ZoneAllocatorHuge_fork_unlock releases it in both processes.
+void ZoneAllocatorHuge_fork_lock(void)
+{
+    pthread_mutex_lock(&huge_lock);
+}
+
+void ZoneAllocatorHuge_fork_unlock(void)
+{
+    pthread_mutex_unlock(&huge_lock);
+}
+
+// Returns the mapped size of the huge block pointed to by ptr, the block can grow up to it in place.
+// Returns 0 if ptr is not a huge block.
+size_t ZoneAllocatorHuge_capacity_get(void *ptr)
+{
+    size_t ret = 0u;
+    size_t slot;
+
+    pthread_mutex_lock(&huge_lock);
+    slot = slot_find((uintptr_t)ptr);
+    if (slot != huge_table_size)
+    {
+        ret = huge_table[slot].mapped_size;
+    }
+    pthread_mutex_unlock(&huge_lock);
+    return (ret);
+}
+
+// Returns the size from which requests are served by the huge tier.
+size_t ZoneAllocatorHuge_threshold_get(void)
+{
+    return (__atomic_load_n(&huge_threshold, __ATOMIC_RELAXED));
+}
+
+// Sets the size from which requests are served by the huge tier.
+// Returns 0 on success, -1 if the threshold is below HUGE_THRESHOLD_MIN.
+short ZoneAllocatorHuge_threshold_set(size_t threshold)
+{
+    if (threshold < HUGE_THRESHOLD_MIN)
+    {
+        return (-1);
+    }
+    __atomic_store_n(&huge_threshold, threshold, __ATOMIC_RELAXED);
+    return (0);
+}
+
+// This function prints the huge blocks.
+// It prints the start address, end address, and size of each block.
+void ZoneAllocatorHuge_report(void)
+{
+    pthread_mutex_lock(&huge_lock);
+    if (huge_table_cnt != 0u)
+    {
+        write (1, "HUGE :\n", 7);
+        for (size_t i = 0u; i < huge_table_size; i++)
+        {
+            if (huge_table[i].start > HUGE_SLOT_DELETED)
+            {
+                print_address_as_hex((void *)huge_table[i].start); // Print the address of the block
+                write (1, " - ", 3);
+                print_address_as_hex((void *)(huge_table[i].start + huge_table[i].used)); // Print the end address
+                write (1, " : ", 3);
+                print_size(huge_table[i].used); // Print the size of the block
+                write (1, "\n", 1);
+            }
+        }
+    }
+    pthread_mutex_unlock(&huge_lock);
+}
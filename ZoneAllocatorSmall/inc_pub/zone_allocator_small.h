@@ -2,17 +2,43 @@
 #define IG_ZONE_ALLOCATOR_SMALL_H
 
 #include <stdlib.h>
+#include <inttypes.h>
 
 
 #define SMALL_ALLOC_SIZE_MAX 4066u // Size of the small allocation
 #define SMALL_ALLOC_SIZE_MIN 64u // Minimum size of the small allocation
+#define SMALL_BIN_EXACT_COUNT 64u // Bins holding a single block size, 16 bytes apart
+#define SMALL_BIN_LOG_STEPS 4u // Bins per power of two above the exact bins
+#define SMALL_BIN_COUNT 128u // Number of free block bins
+#define SMALL_BIN_WORDS (SMALL_BIN_COUNT / 64u) // Words of the bin occupancy bitmap
 
-void *ZoneAllocatorSmall_alloc(size_t size);
-short ZoneAllocatorSmall_free(void *ptr);
-short ZoneAllocatorSmall_realloc(void **ptr, size_t size);
+typedef struct small_zone_header small_zone_header_t;
+typedef struct small_map small_map_t;
 
-size_t ZoneAllocatorSmall_size_get(void *ptr);
-void ZoneAllocatorSmall_report(void);
+// State of the small zones of an arena, more zones are mapped when the bins run dry
+typedef struct
+{
+    small_map_t *maps; // Mapped small zones
+    size_t map_cnt; // Number of mapped small zones
+    small_zone_header_t *bins[SMALL_BIN_COUNT]; // Free blocks of every zone binned by size
+    uint64_t bin_bitmap[SMALL_BIN_WORDS]; // Bit set if the bin holds at least one block
+    size_t purge_epoch; // Purge ticks run on the zone, stamped on the blocks it frees
+    uint8_t arena_id; // Arena registered as owner of the zones
+} small_zone_t;
+
+void *ZoneAllocatorSmall_alloc(small_zone_t *zone, size_t size);
+void *ZoneAllocatorSmall_calloc(small_zone_t *zone, size_t size);
+size_t ZoneAllocatorSmall_alloc_batch(small_zone_t *zone, size_t size, size_t count, void **out);
+short ZoneAllocatorSmall_free(small_zone_t *zone, void *ptr);
+size_t ZoneAllocatorSmall_free_batch(small_zone_t *zone, void **ptrs, size_t count);
+short ZoneAllocatorSmall_realloc(small_zone_t *zone, void **ptr, size_t size);
+
+size_t ZoneAllocatorSmall_size_get(small_zone_t *zone, void *ptr);
+size_t ZoneAllocatorSmall_capacity_get(void *ptr);
+void ZoneAllocatorSmall_used_set(void *ptr, size_t size);
+size_t ZoneAllocatorSmall_purge(small_zone_t *zone);
+size_t ZoneAllocatorSmall_trim(small_zone_t *zone, size_t *pad);
+void ZoneAllocatorSmall_report(small_zone_t *zone);
 
 
 #endif // IG_ZONE_ALLOCATOR_SMALL_H
\ No newline at end of file
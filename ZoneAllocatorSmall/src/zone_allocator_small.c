@@ -1,308 +1,728 @@
 #include "../inc_pub/zone_allocator_small.h"
 #include "../../print_utils/inc_pub/print_utils.h"
+#include "../../PageMap/inc_pub/page_map.h"
+#include "../../MapCache/inc_pub/map_cache.h"
 #include <sys/mman.h>
 #include <inttypes.h>
 #include <unistd.h>
+#include <string.h>
 #include <stdio.h>
 
-typedef struct
+// Header of a block. The next block starts right after the payload,
+// so the physical list only needs a link to the previous block.
+struct small_zone_header
 {
+    small_zone_header_t *prev; // Physical block before this one, NULL for the first block of a zone
     size_t size; // Size of the block
-    size_t used; // Used size of the block
-    void *next; // Pointer to the next block
-} small_zone_header_t;
+    size_t used; // Used size of the block, 0 if the block is free
+    size_t magic; // SMALL_HEADER_MAGIC while the header is live
+};
+
+// Header of one mapped small zone, its blocks follow it
+struct small_map
+{
+    small_map_t *next; // Next zone of the arena
+    small_map_t *prev; // Previous zone of the arena
+    size_t mapped_size; // Used for munmap
+    size_t alloced_cnt; // Number of allocated blocks
+    short huge; // 1 if the zone is one huge page, purges never split it
+};
+
+// Links of a free block, kept in its payload
+typedef struct
+{
+    small_zone_header_t *next; // Next free block of the same bin
+    small_zone_header_t *prev; // Previous free block of the same bin
+    size_t epoch; // Purge epoch of the zone when the block was freed, SMALL_PURGED once its pages are given back
+} small_free_links_t;
 
 
 #define SMALL_ALLOC_COUNT 100u // Number of allocations
 #define SMALL_HEADER_SIZE sizeof(small_zone_header_t) // Size of the header
 #define SMALL_ZONE_SIZE ((SMALL_ALLOC_SIZE_MAX + SMALL_HEADER_SIZE) * SMALL_ALLOC_COUNT)  // Total size of the small zone
 #define SMALL_ALLOC_ALIGMENT 16u // Alignment of the small allocation
+#define SMALL_MAP_HEADER_SIZE (((sizeof(small_map_t) + SMALL_ALLOC_ALIGMENT - 1u) / SMALL_ALLOC_ALIGMENT) * SMALL_ALLOC_ALIGMENT) // Zone header, keeps the blocks 16 byte aligned
+#define SMALL_MAP_FIRST_BLOCK(map) ((small_zone_header_t *)((uint8_t *)(map) + SMALL_MAP_HEADER_SIZE)) // First block of a zone
+#define SMALL_BLOCK_SIZE_MIN (((sizeof(small_free_links_t) + SMALL_ALLOC_ALIGMENT - 1u) / SMALL_ALLOC_ALIGMENT) * SMALL_ALLOC_ALIGMENT) // Smallest payload, a free block has to hold its links
+#define SMALL_LINKS(header) ((small_free_links_t *)((uint8_t *)(header) + SMALL_HEADER_SIZE)) // Free list links of a free block
+#define SMALL_HEADER_MAGIC (size_t)0x5e11a110c8b10c4bu // Marks a live header, cleared when the header is merged away
+#define SMALL_PURGED SIZE_MAX // Epoch of a free block whose pages were given back to the system
+
+// Every block starts 16 byte aligned and the header is 32 bytes, so every payload is 16 byte aligned,
+// every payload size is a multiple of 16 and all the blocks of an exact bin have the same size.
+
+// Returns the bin holding free blocks of the given payload size.
+static size_t bin_index_get(size_t size)
+{
+    size_t log;
+
+    if (size < SMALL_BIN_EXACT_COUNT * SMALL_ALLOC_ALIGMENT)
+    {
+        return (size / SMALL_ALLOC_ALIGMENT);
+    }
+    log = 63u - (size_t)__builtin_clzll(size);
+    size = SMALL_BIN_EXACT_COUNT + ((log - 10u) * SMALL_BIN_LOG_STEPS) + ((size >> (log - 2u)) & (SMALL_BIN_LOG_STEPS - 1u));
+    return ((size < SMALL_BIN_COUNT) ? (size) : (SMALL_BIN_COUNT - 1u));
+}
+
+// Returns the smallest payload size of the blocks of a bin.
+static size_t bin_size_min(size_t bin)
+{
+    size_t log;
+
+    if (bin < SMALL_BIN_EXACT_COUNT)
+    {
+        return (bin * SMALL_ALLOC_ALIGMENT);
+    }
+    log = 10u + ((bin - SMALL_BIN_EXACT_COUNT) / SMALL_BIN_LOG_STEPS);
+    return (((size_t)1u << log) + (((bin - SMALL_BIN_EXACT_COUNT) % SMALL_BIN_LOG_STEPS) << (log - 2u)));
+}
+
+static void bin_add(small_zone_t *zone, small_zone_header_t *block)
+{
+    size_t bin = bin_index_get(block->size);
+    small_free_links_t *links = SMALL_LINKS(block);
+
+    links->prev = NULL;
+    links->next = zone->bins[bin];
+    if (links->next != NULL)
+    {
+        SMALL_LINKS(links->next)->prev = block;
+    }
+    zone->bins[bin] = block;
+    zone->bin_bitmap[bin / 64u] |= (uint64_t)1u << (bin % 64u);
+}
+
+static void bin_remove(small_zone_t *zone, small_zone_header_t *block)
+{
+    size_t bin = bin_index_get(block->size);
+    small_free_links_t *links = SMALL_LINKS(block);
 
+    if (links->prev == NULL)
+    {
+        zone->bins[bin] = links->next;
+    }
+    else
+    {
+        SMALL_LINKS(links->prev)->next = links->next;
+    }
+    if (links->next != NULL)
+    {
+        SMALL_LINKS(links->next)->prev = links->prev;
+    }
+    if (zone->bins[bin] == NULL)
+    {
+        zone->bin_bitmap[bin / 64u] &= ~((uint64_t)1u << (bin % 64u));
+    }
+}
 
-void *small_zone_start = NULL; // Pointer to the small zone
-void *small_zone_end = NULL; // Pointer to the small zone
-size_t small_zone_mapped_size = 0u;
-uint16_t small_alloced_cnt = 0u; // Number of allocated blocks
+// Returns the first free block of the first non empty bin whose blocks all fit size, NULL if none.
+static small_zone_header_t *bin_find(small_zone_t *zone, size_t size)
+{
+    size_t bin = bin_index_get(size);
+    uint64_t word;
 
+    if (bin_size_min(bin) < size)
+    {
+        bin++; // Some blocks of the bin are too small, start at the next one
+    }
+    while (bin < SMALL_BIN_COUNT)
+    {
+        word = zone->bin_bitmap[bin / 64u] & (UINT64_MAX << (bin % 64u));
+        if (word != 0u)
+        {
+            return (zone->bins[((bin / 64u) * 64u) + (size_t)__builtin_ctzll(word)]);
+        }
+        bin = ((bin / 64u) + 1u) * 64u; // Next bitmap word
+    }
+    return (NULL);
+}
 
+// Returns the physical block after block, NULL if block is the last one of its zone.
+static small_zone_header_t *block_next(small_map_t *map, small_zone_header_t *block)
+{
+    uint8_t *next = (uint8_t *)block + SMALL_HEADER_SIZE + block->size;
+
+    return ((next < (uint8_t *)map + map->mapped_size) ? ((small_zone_header_t *)next) : (NULL));
+}
+
+// Makes the block after block point back to it once block has grown or shrunk.
+static void block_next_link(small_map_t *map, small_zone_header_t *block)
+{
+    small_zone_header_t *next_header = block_next(map, block);
+
+    if (next_header != NULL)
+    {
+        next_header->prev = block;
+    }
+}
 
-// Allocates a block of memory of the given size.
-void *ZoneAllocatorSmall_alloc(size_t size)
+// Cuts the tail of a block past size into a new free block if it is large enough to be one.
+// The new block gets the epoch of the free block its pages come from, they are neither older nor newer.
+static void block_split(small_zone_t *zone, small_map_t *map, small_zone_header_t *block, size_t size, size_t epoch)
 {
+    small_zone_header_t *next_header;
+
+    if (block->size >= size + SMALL_HEADER_SIZE + SMALL_BLOCK_SIZE_MIN)
+    {
+        next_header = (small_zone_header_t *)((uint8_t *)block + SMALL_HEADER_SIZE + size); // Set the next header
+        next_header->prev = block; // Set the previous pointer
+        next_header->size = block->size - size - SMALL_HEADER_SIZE; // Set the size of the next block
+        next_header->used = 0u; // Set the used flag
+        next_header->magic = SMALL_HEADER_MAGIC;
+        block->size = size; // Set the size of the block
+        block_next_link(map, next_header);
+        bin_add(zone, next_header);
+        SMALL_LINKS(next_header)->epoch = epoch;
+    }
+}
+
+// Returns the payload size of a block that holds size bytes.
+static size_t block_size_get(size_t size)
+{
+    size_t full_size = size + SMALL_HEADER_SIZE;
+    size_t aligned_size = full_size / SMALL_ALLOC_ALIGMENT; // Calculate the aligned size
+    aligned_size = (full_size % SMALL_ALLOC_ALIGMENT == 0u) ? (aligned_size) : (aligned_size + 1); // Align to 16
+    aligned_size *= SMALL_ALLOC_ALIGMENT; // Align the size
+    aligned_size -= SMALL_HEADER_SIZE;
+    return ((aligned_size < SMALL_BLOCK_SIZE_MIN) ? (SMALL_BLOCK_SIZE_MIN) : (aligned_size));
+}
+
+// Maps a new small zone, registers its pages and bins its single free block.
+// In huge page mode the zones mapped once the first one is full are one huge page each.
+// The block of a new mapping is marked purged: its pages read as zero like the pages of a purged block.
+static small_map_t *map_new(small_zone_t *zone)
+{
+    small_map_t *map;
     small_zone_header_t *start_header;
+    short zeroed;
+    int page_size = sysconf(_SC_PAGESIZE) ; // Get the page size
+    size_t mapped_size = SMALL_ZONE_SIZE / page_size; // Calculate the number of aligned blocks
+    short huge = (zone->map_cnt != 0u) ? (MapCache_huge_get()) : (0);
 
+    mapped_size = (mapped_size * page_size) + ((SMALL_ZONE_SIZE % page_size == 0u) ? (0u) : ((size_t)page_size)); // Align to page size
+    if (huge != 0)
+    {
+        mapped_size = ((mapped_size + MAP_CACHE_HUGE_PAGE_SIZE - 1u) / MAP_CACHE_HUGE_PAGE_SIZE) * MAP_CACHE_HUGE_PAGE_SIZE; // Align to huge page size
+    }
+    map = MapCache_map(PAGE_MAP_ZONE_SMALL, mapped_size, huge, &zeroed);
+    if (map == NULL)
+    {
+        return (NULL); // Allocation failed
+    }
+    if (PageMap_register(map, mapped_size, PAGE_MAP_ZONE_SMALL, zone->arena_id, map) != 0)
+    {
+        MapCache_unmap((void *)map, mapped_size, huge);
+        return (NULL); // Ownership could not be recorded
+    }
+    map->mapped_size = mapped_size;
+    map->huge = huge;
+    map->alloced_cnt = 0u;
+    map->prev = NULL;
+    map->next = zone->maps;
+    if (map->next != NULL)
+    {
+        map->next->prev = map;
+    }
+    zone->maps = map;
+    zone->map_cnt++;
+    start_header = SMALL_MAP_FIRST_BLOCK(map); // Set the start header
+    start_header->prev = NULL; // Set the previous pointer
+    start_header->size = mapped_size - SMALL_MAP_HEADER_SIZE - SMALL_HEADER_SIZE; // Set the size of the block
+    start_header->used = 0u; // Set the used flag
+    start_header->magic = SMALL_HEADER_MAGIC;
+    bin_add(zone, start_header);
+    SMALL_LINKS(start_header)->epoch = (zeroed != 0) ? (SMALL_PURGED) : (zone->purge_epoch);
+    return (map);
+}
+
+// Unlinks an empty zone from the arena and unregisters its pages. Its single free block must already be out of the bins.
+static void map_unlink(small_zone_t *zone, small_map_t *map)
+{
+    if (map->prev == NULL)
+    {
+        zone->maps = map->next;
+    }
+    else
+    {
+        map->prev->next = map->next;
+    }
+    if (map->next != NULL)
+    {
+        map->next->prev = map->prev;
+    }
+    zone->map_cnt--;
+    PageMap_unregister(map, map->mapped_size);
+}
+
+// Gives an empty zone back to the system. Its single free block must already be out of the bins.
+static void map_release(small_zone_t *zone, small_map_t *map)
+{
+    map_unlink(zone, map);
+    MapCache_unmap((void *)map, map->mapped_size, map->huge);
+}
+
+// Returns the header of the allocated block ptr points to and the zone that holds it, NULL if ptr is not a live block.
+// The header sits right before the payload, the page map and the magic value tell whether it is one.
+static small_zone_header_t *block_get(void *ptr, small_map_t **map)
+{
+    small_zone_header_t *header = (small_zone_header_t *)((uint8_t *)ptr - SMALL_HEADER_SIZE);
+
+    *map = PageMap_owner_get(ptr, PAGE_MAP_ZONE_SMALL);
+    if ((*map == NULL) || (((uintptr_t)ptr % SMALL_ALLOC_ALIGMENT) != 0u) || (header < SMALL_MAP_FIRST_BLOCK(*map)))
+    {
+        return (NULL); // Pointer out of range or not aligned
+    }
+    if ((header->magic != SMALL_HEADER_MAGIC) || (header->used == 0u))
+    {
+        return (NULL); // Not a live block
+    }
+    return (header);
+}
+
+// Returns in start and end the whole pages between the links and the end of a free block,
+// the pages a purge gives back. In a huge page zone only whole huge pages count. start >= end if there is none.
+static void block_purge_range(small_zone_header_t *block, uintptr_t *start, uintptr_t *end)
+{
+    const small_map_t *map = PageMap_owner_get(block, PAGE_MAP_ZONE_SMALL);
+    const uintptr_t page_size = (map->huge != 0) ? ((uintptr_t)MAP_CACHE_HUGE_PAGE_SIZE) : ((uintptr_t)sysconf(_SC_PAGESIZE)); // Get the page size
+
+    *start = ((uintptr_t)(SMALL_LINKS(block) + 1) + page_size - 1u) & ~(page_size - 1u);
+    *end = ((uintptr_t)block + SMALL_HEADER_SIZE + block->size) & ~(page_size - 1u);
+}
+
+// Allocates a block of memory of the given size, cleared if zero is set.
+// The block is taken from the first bin that fits, the rest of it goes back to the bins.
+// A new zone is mapped when no free block of any zone fits.
+// Clearing skips the pages of a purged block or of the untouched tail of a new zone, they still read as zero.
+static void *block_alloc(small_zone_t *zone, size_t size, short zero)
+{
+    small_zone_header_t *current_header;
+    small_map_t *map;
+    size_t block_size;
+    uint8_t *payload;
+    uintptr_t zero_start;
+    uintptr_t zero_end;
 
     if (size == 0 || size > SMALL_ALLOC_SIZE_MAX)
     {
         return NULL; // Invalid size
     }
-    if (small_zone_start == NULL)
+    block_size = block_size_get(size);
+    current_header = bin_find(zone, block_size);
+    if (current_header == NULL)
     {
-        int page_size = sysconf(_SC_PAGESIZE) ; // Get the page size
-        small_zone_mapped_size = SMALL_ZONE_SIZE / page_size; // Calculate the number of aligned blocks
-        small_zone_mapped_size = (small_zone_mapped_size * page_size) + ((SMALL_ZONE_SIZE % page_size == 0u) ? (0u) : (page_size)); // Align to page size
-        small_zone_start = mmap(NULL, small_zone_mapped_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
-        if (small_zone_start == MAP_FAILED)
+        if (map_new(zone) == NULL)
         {
             return NULL; // Allocation failed
         }
-        small_zone_end = (void *)((uint8_t *)small_zone_start + SMALL_ZONE_SIZE); // Set the end pointer
-        start_header = (small_zone_header_t *)small_zone_start; // Set the start header
-        start_header->size = small_zone_mapped_size; // Set the size of the block
-        start_header->used = 0u; // Set the used flag
-        start_header->next = NULL; // Set the next pointer
-        small_alloced_cnt = 0u;
-    }
-    small_zone_header_t *current_header = (small_zone_header_t *)small_zone_start; // Set the current header
-	size_t full_size = size + SMALL_HEADER_SIZE;
-    size_t aligned_size = full_size / SMALL_ALLOC_ALIGMENT; // Calculate the aligned size 
-    aligned_size = (full_size % SMALL_ALLOC_ALIGMENT == 0u) ? (aligned_size) : (aligned_size + 1); // Align to 16
-	aligned_size *= SMALL_ALLOC_ALIGMENT; // Align the size
-    while (current_header != NULL)
+        current_header = bin_find(zone, block_size);
+    }
+    map = PageMap_owner_get(current_header, PAGE_MAP_ZONE_SMALL);
+    payload = (uint8_t *)current_header + SMALL_HEADER_SIZE;
+    zero_start = (uintptr_t)payload + size;
+    zero_end = (uintptr_t)payload + size;
+    if ((zero != 0) && (SMALL_LINKS(current_header)->epoch == SMALL_PURGED))
+    {
+        block_purge_range(current_header, &zero_start, &zero_end); // Read before the split shrinks the block
+        zero_end = (zero_end < (uintptr_t)payload + size) ? (zero_end) : ((uintptr_t)payload + size);
+        zero_start = (zero_start < zero_end) ? (zero_start) : ((uintptr_t)payload + size);
+        zero_end = (zero_start < zero_end) ? (zero_end) : ((uintptr_t)payload + size);
+    }
+    bin_remove(zone, current_header);
+    block_split(zone, map, current_header, block_size, SMALL_LINKS(current_header)->epoch);
+    current_header->used = size; // Mark the block as used
+    map->alloced_cnt++;
+    if (zero != 0)
+    {
+        memset(payload, 0, zero_start - (uintptr_t)payload); // Head page, holds the links
+        memset((void *)zero_end, 0, (uintptr_t)payload + size - zero_end);
+    }
+    return ((void *)payload); // Return the pointer to the allocated memory
+}
+
+void *ZoneAllocatorSmall_alloc(small_zone_t *zone, size_t size)
+{
+    return (block_alloc(zone, size, 0));
+}
+
+// Allocates a block of size bytes that reads as zero, only the bytes that may hold old data are written.
+void *ZoneAllocatorSmall_calloc(small_zone_t *zone, size_t size)
+{
+    return (block_alloc(zone, size, 1));
+}
+
+// Allocates count blocks of size bytes into out, cut back to back out of as few free blocks as possible.
+// A free block large enough for the whole batch is preferred, it is unbinned once and its rest is split off once.
+// Returns the number of blocks allocated, less than count only if no zone could be mapped.
+size_t ZoneAllocatorSmall_alloc_batch(small_zone_t *zone, size_t size, size_t count, void **out)
+{
+    small_zone_header_t *current_header;
+    small_zone_header_t *next_header;
+    small_map_t *map;
+    size_t block_size;
+    size_t want;
+    size_t epoch;
+    size_t done = 0u;
+    uint8_t *end;
+
+    if (size == 0 || size > SMALL_ALLOC_SIZE_MAX)
     {
-        if (current_header->used == 0u && current_header->size >= aligned_size)
+        return (0); // Invalid size
+    }
+    block_size = block_size_get(size);
+    while (done < count)
+    {
+        want = count - done;
+        want = (want < SMALL_ZONE_SIZE / (block_size + SMALL_HEADER_SIZE)) ? (want) : (SMALL_ZONE_SIZE / (block_size + SMALL_HEADER_SIZE));
+        current_header = bin_find(zone, (want * (block_size + SMALL_HEADER_SIZE)) - SMALL_HEADER_SIZE);
+        if (current_header == NULL)
         {
-            if (current_header->size > aligned_size)
+            current_header = bin_find(zone, block_size); // No block fits the batch, fill the free ones in order
+        }
+        if (current_header == NULL)
+        {
+            if (map_new(zone) == NULL)
             {
-                small_zone_header_t *next_header = (small_zone_header_t *)((uint8_t *)current_header + aligned_size); // Set the next header
-                next_header->size = current_header->size - aligned_size - SMALL_HEADER_SIZE; // Set the size of the next block
-                next_header->used = 0u; // Set the used flag
-                next_header->next = current_header->next; // Set the next pointer
-                current_header->next = next_header; // Set the next pointer of the current block
+                break; // Allocation failed
             }
-			current_header->used = size; // Mark the block as used
-            current_header->size = aligned_size - SMALL_HEADER_SIZE; // Set the size of the block
-            small_alloced_cnt++;
-            break;
+            current_header = bin_find(zone, block_size);
         }
-        current_header = (small_zone_header_t *)current_header->next; // Move to the next block
+        map = PageMap_owner_get(current_header, PAGE_MAP_ZONE_SMALL);
+        epoch = SMALL_LINKS(current_header)->epoch;
+        end = (uint8_t *)current_header + SMALL_HEADER_SIZE + current_header->size;
+        bin_remove(zone, current_header);
+        while (1)
+        {
+            current_header->used = size; // Mark the block as used
+            current_header->magic = SMALL_HEADER_MAGIC;
+            out[done++] = (void *)((uint8_t *)current_header + SMALL_HEADER_SIZE);
+            map->alloced_cnt++;
+            next_header = (small_zone_header_t *)((uint8_t *)current_header + SMALL_HEADER_SIZE + block_size);
+            if ((done == count) || ((uint8_t *)next_header + SMALL_HEADER_SIZE + block_size > end))
+            {
+                break;
+            }
+            current_header->size = block_size;
+            next_header->prev = current_header;
+            current_header = next_header;
+        }
+        current_header->size = (size_t)(end - ((uint8_t *)current_header + SMALL_HEADER_SIZE)); // The last block holds the rest
+        block_next_link(map, current_header);
+        block_split(zone, map, current_header, block_size, epoch);
     }
+    return (done);
+}
+
+size_t ZoneAllocatorSmall_size_get(small_zone_t *zone, void *ptr)
+{
+    small_zone_header_t *current_header;
+    small_map_t *map;
+
+    (void)zone;
+    if (ptr == NULL)
+    {
+        return (0); // Invalid pointer
+    }
+    current_header = block_get(ptr, &map);
     if (current_header == NULL)
     {
-        return NULL; // No free block found
+        return (0); // Not found
     }
-    return ((void *)((uint8_t *)current_header + SMALL_HEADER_SIZE)); // Return the pointer to the allocated memory
+    return (current_header->size);
 }
 
-size_t ZoneAllocatorSmall_size_get(void *ptr)
+// Returns the payload size of the allocated block ptr, the block can grow up to it in place.
+// Returns 0 if ptr is not a live block. Only the header of the block is read, so the owner of the block may call it without the arena lock.
+size_t ZoneAllocatorSmall_capacity_get(void *ptr)
 {
-    size_t ret = 0;
+    small_zone_header_t *header;
+    small_map_t *map;
 
     if (ptr == NULL)
     {
-        ret = 0; // Invalid pointer
+        return (0);
+    }
+    header = block_get(ptr, &map);
+    return ((header == NULL) ? (0) : (header->size));
+}
+
+// Records a new used size for an allocated block that fits its payload.
+// Only the header of the block is written, so the owner of the block may call it without the arena lock.
+void ZoneAllocatorSmall_used_set(void *ptr, size_t size)
+{
+    small_zone_header_t *header = (small_zone_header_t *)((uint8_t *)ptr - SMALL_HEADER_SIZE);
+
+    if ((size != 0u) && (size <= header->size))
+    {
+        header->used = size;
     }
-    else if (ptr < small_zone_start|| ptr > small_zone_end)
+}
+
+// Merges a freed block with its free physical neighbors and returns the merged block, not binned yet.
+static small_zone_header_t *defrag(small_zone_t *zone, small_map_t *map, small_zone_header_t *block)
+{
+    small_zone_header_t* next_block = block_next(map, block);
+    small_zone_header_t* prev_block = block->prev;
+
+    if ((next_block != NULL) && (next_block->used == 0u))
     {
-        ret = 0; // Pointer out of range
+        bin_remove(zone, next_block);
+        block->size += SMALL_HEADER_SIZE + next_block->size;
+        next_block->magic = 0u;
     }
-    else
+    if ((prev_block != NULL) && (prev_block->used == 0u))
     {
-		small_zone_header_t *current_header = (small_zone_header_t *)small_zone_start; // Set the current header
-		while (current_header != NULL)
-    	{
-			if ((void *)((uint8_t *)current_header + SMALL_HEADER_SIZE) == ptr)
-			{
-				ret = current_header->size; //Found
-				break;
-			}
-			current_header = (small_zone_header_t *)current_header->next; // Move to the next block
-		}
-		if (current_header == NULL)
-		{
-			ret = 0; //Not found
-		}
-    }
-    return (ret);
+        bin_remove(zone, prev_block);
+        prev_block->size += SMALL_HEADER_SIZE + block->size;
+        block->magic = 0u;
+        block = prev_block;
+    }
+    block_next_link(map, block);
+    return (block);
 }
 
-static void defrag(small_zone_header_t* prev_block, small_zone_header_t *block)
-{
-	if (block != NULL)
-	{
-		small_zone_header_t* next_block = block->next;
-		size_t size = block->size;
-		small_zone_header_t* temp_block = block->next;
-
-		if (next_block != NULL)
-		{
-			if (next_block->used == 0)
-			{
-				size += next_block->size;
-				temp_block = next_block->next;
-			}
-		}
-		if (prev_block != NULL)
-		{
-			if (prev_block->used == 0)
-			{
-				size += prev_block->size;
-				prev_block->size = size;
-				prev_block->next = temp_block;
-				return;
-			}
-		}
-		block->size = size;
-		block->next = temp_block;
-		return;
-	}
-	
+// Gives a freed block back: merges it with its free neighbors, then bins it,
+// or gives its zone back to the system if the zone is empty and not the last one of the arena.
+static void block_release(small_zone_t *zone, small_map_t *map, small_zone_header_t *block)
+{
+    block = defrag(zone, map, block);
+    if ((map->alloced_cnt == 0u) && (zone->map_cnt > 1u))
+    {
+        map_release(zone, map); // The merged block spans the whole zone, it is not binned
+    }
+    else
+    {
+        bin_add(zone, block);
+        SMALL_LINKS(block)->epoch = zone->purge_epoch; // Dirty, even if merged with purged neighbors
+    }
 }
 
 // Frees the memory block pointed to by ptr.
-short ZoneAllocatorSmall_free(void *ptr)
+// A zone left empty is given back to the system unless it is the last zone of the arena.
+short ZoneAllocatorSmall_free(small_zone_t *zone, void *ptr)
 {
-    short ret = 0;
+    small_zone_header_t *current_header;
+    small_map_t *map;
+
     if (ptr == NULL)
     {
-        ret = -1; // Invalid pointer
-    }
-    else if (ptr < small_zone_start || ptr > small_zone_end)
-    {
-        ret = -2; // Pointer out of range
-    }
-	else
-    {
-		small_zone_header_t *current_header = (small_zone_header_t *)small_zone_start; // Set the current header
-		small_zone_header_t *prev_header = NULL;
-		while (current_header != NULL)
-    	{
-			if ((void *)((uint8_t *)current_header + SMALL_HEADER_SIZE) == ptr)
-			{
-				current_header->used = 0; //Freed
-				small_alloced_cnt--;
-				defrag(prev_header, current_header);
-				break;
-			}
-			prev_header = current_header;
-			current_header = (small_zone_header_t *)current_header->next; // Move to the next block
-		}
-		if (small_alloced_cnt == 0u)
-		{
-			munmap((void *)small_zone_start, small_zone_mapped_size);
-			small_zone_mapped_size = 0u;
-			small_zone_start = NULL;
-			small_zone_end = NULL;
-		}
-		if (current_header == NULL)
-		{
-			ret = -2; //Not found
-		}
-    }
-    return (ret);
+        return (-1); // Invalid pointer
+    }
+    current_header = block_get(ptr, &map);
+    if (current_header == NULL)
+    {
+        return (-2); // Not found
+    }
+    current_header->used = 0; //Freed
+    map->alloced_cnt--;
+    block_release(zone, map, current_header);
+    return (0);
 }
 
-// This function only performs a realocation if the pointer is valid and the size is valid for the small zone.
-// It checks if the pointer is in the small zone.
-short ZoneAllocatorSmall_realloc(void **ptr, size_t size)
+// Frees the blocks of ptrs. A row of blocks that follow each other both in ptrs and in memory, in address order,
+// is merged into one free block first, then merged with its neighbors and binned once.
+// Pointers that are not live blocks are skipped. Returns the number of blocks freed.
+size_t ZoneAllocatorSmall_free_batch(small_zone_t *zone, void **ptrs, size_t count)
 {
-	short ret = -1;
+    small_zone_header_t *first;
+    small_zone_header_t *last;
+    small_zone_header_t *next;
+    small_map_t *map;
+    size_t freed = 0u;
+    size_t row;
+    size_t i = 0u;
 
-    if (*ptr == NULL)
+    while (i < count)
     {
-        *ptr = NULL; // Invalid pointer
+        first = (ptrs[i] == NULL) ? (NULL) : (block_get(ptrs[i], &map));
+        i++;
+        if (first == NULL)
+        {
+            continue; // Not a live block
+        }
+        last = first;
+        row = 1u;
+        while ((i < count) && ((next = block_next(map, last)) != NULL) && (next->used != 0u)
+            && ((uint8_t *)ptrs[i] == (uint8_t *)next + SMALL_HEADER_SIZE))
+        {
+            next->magic = 0u; // Merged into first
+            last = next;
+            row++;
+            i++;
+        }
+        first->size = (size_t)((uint8_t *)last + last->size - (uint8_t *)first);
+        first->used = 0u;
+        map->alloced_cnt -= row;
+        freed += row;
+        block_release(zone, map, first);
     }
-    else if ((size == 0) || (size > SMALL_ALLOC_SIZE_MAX))
+    return (freed);
+}
+
+// This function only performs an in place realocation if the pointer is valid and the size is valid for the small zone.
+// It grows the block into the following free block when possible.
+// It returns 0 on success, otherwise the block is left untouched and the caller has to move it.
+short ZoneAllocatorSmall_realloc(small_zone_t *zone, void **ptr, size_t size)
+{
+    small_zone_header_t *current_header;
+    small_zone_header_t *next_header;
+    small_map_t *map;
+    size_t block_size;
+
+    if ((ptr == NULL) || (*ptr == NULL))
     {
-		ret = ZoneAllocatorSmall_free(*ptr);
-        *ptr =  NULL; // Invalid size
+        return (-1); // Invalid pointer
     }
-    else if (*ptr < small_zone_start || *ptr > small_zone_end)
+    if ((size == 0) || (size > SMALL_ALLOC_SIZE_MAX))
     {
-        *ptr = NULL; // Pointer out of range
+        return (-1); // Invalid size
     }
-    else
+    current_header = block_get(*ptr, &map);
+    if (current_header == NULL)
+    {
+        return (-2); // Not found
+    }
+    block_size = block_size_get(size);
+    if (current_header->size < block_size)
     {
-		small_zone_header_t *current_header = (small_zone_header_t *)small_zone_start; // Set the current header
-		small_zone_header_t *prev_header = NULL;
-		while (current_header != NULL)
-    	{
-			if ((void *)((uint8_t *)current_header + SMALL_HEADER_SIZE) == *ptr)
-			{
-				size_t full_size = size + SMALL_HEADER_SIZE;
-				size_t aligned_size = full_size / SMALL_ALLOC_ALIGMENT; // Calculate the aligned size 
-				aligned_size = (full_size % SMALL_ALLOC_ALIGMENT == 0u) ? (aligned_size) : (aligned_size + 1); // Align to 16
-				aligned_size *= SMALL_ALLOC_ALIGMENT; // Align the size
-				aligned_size -= SMALL_HEADER_SIZE;
-				if (current_header->size < aligned_size)
-				{
-					small_zone_header_t* next_header = current_header->next;
-					if (next_header != NULL)
-					{
-						
-						size_t new_size = (next_header->used == 0u) ? (next_header->size) : 0u;
-						new_size += (current_header->size  + SMALL_HEADER_SIZE);
-						if (new_size >= aligned_size)
-						{
-							current_header->used = size; // Mark the block as used
-            				current_header->size = aligned_size; // Set the size of the block
-							current_header->next = next_header->next;
-							if (new_size > aligned_size)
-							{
-								next_header = (small_zone_header_t *)((uint8_t *)current_header + aligned_size + SMALL_HEADER_SIZE); // Set the next header
-								next_header->size = new_size - aligned_size; // Set the size of the next block
-								next_header->next = current_header->next; // Set the next pointer
-								current_header->next = next_header; // Set the next pointer of the current block
-							}
-							return (0);
-						}
-					}
-					current_header->used = 0; //Freed
-					small_alloced_cnt--;
-					defrag(prev_header, current_header);
-					current_header = NULL;
-				}
-				else
-				{
-					current_header->used = size;
-					return (0);
-				}
-				
-				break;
-			}
-			prev_header = current_header;
-			current_header = (small_zone_header_t *)current_header->next; // Move to the next block
-		}
-		if (current_header == NULL)
-		{
-			*ptr = ZoneAllocatorSmall_alloc(size);
-			ret = 0;
-		}
-		if (small_alloced_cnt == 0u)
-		{
-			munmap((void *)small_zone_start, small_zone_mapped_size);
-			small_zone_mapped_size = 0u;
-			small_zone_start = NULL;
-		}
-    }
-	return (ret);
+        next_header = block_next(map, current_header);
+        if ((next_header == NULL) || (next_header->used != 0u)
+            || (current_header->size + SMALL_HEADER_SIZE + next_header->size < block_size))
+        {
+            return (-1); // The next block can not make room
+        }
+        bin_remove(zone, next_header);
+        current_header->size += SMALL_HEADER_SIZE + next_header->size; // Take the whole free block
+        next_header->magic = 0u;
+        block_next_link(map, current_header);
+        block_split(zone, map, current_header, block_size, SMALL_LINKS(next_header)->epoch); // Give back what is not needed
+    }
+    current_header->used = size; // Mark the block as used
+    return (0);
 }
 
-// This function prints the memory map of the small zone.
-// It prints the start address, end address, and size of each block.
-// It also prints the start address of the snall zone.
-void ZoneAllocatorSmall_report(void)
+// Gives back to the system the whole pages past the links of a free block, they read as zero once touched again.
+// In a huge page zone only whole huge pages are released.
+// Pages that fit the slack left in pad are kept dirty and taken from it.
+// Returns the number of bytes released.
+static size_t block_purge(small_zone_header_t *block, size_t *pad)
 {
-    if (small_zone_start == NULL)
+    uintptr_t start;
+    uintptr_t end;
+
+    block_purge_range(block, &start, &end);
+    if ((start < end) && (end - start <= *pad))
+    {
+        *pad -= end - start; // Kept as slack
+        return (0u);
+    }
+    if (start >= end)
+    {
+        SMALL_LINKS(block)->epoch = SMALL_PURGED; // No whole page inside the block, an allocation clears all of it anyway
+        return (0u);
+    }
+    if (madvise((void *)start, end - start, MADV_DONTNEED) != 0)
+    {
+        return (0u); // Pages kept, the block stays dirty and is tried again on the next purge
+    }
+    SMALL_LINKS(block)->epoch = SMALL_PURGED; // Only now its pages read as zero
+    return (end - start);
+}
+
+// Gives back to the system the pages of the free blocks freed before the last purge tick, then starts a new tick.
+// Returns the number of bytes released.
+size_t ZoneAllocatorSmall_purge(small_zone_t *zone)
+{
+    small_zone_header_t *block;
+    size_t purged = 0u;
+    size_t pad = 0u;
+
+    for (size_t bin = 0u; bin < SMALL_BIN_COUNT; bin++)
+    {
+        for (block = zone->bins[bin]; block != NULL; block = SMALL_LINKS(block)->next)
+        {
+            if (SMALL_LINKS(block)->epoch < zone->purge_epoch) // Not purged yet and not freed during this tick
+            {
+                purged += block_purge(block, &pad);
+            }
+        }
+    }
+    zone->purge_epoch++;
+    return (purged);
+}
+
+// Unmaps the empty zones, the last one included, and gives back the pages of every free block whatever its age.
+// Zones and pages that fit the slack left in pad are kept and taken from it.
+// Only the zones and the free blocks are walked, never the allocated blocks.
+// Returns the number of bytes released.
+size_t ZoneAllocatorSmall_trim(small_zone_t *zone, size_t *pad)
+{
+    small_map_t *map = zone->maps;
+    small_map_t *next;
+    small_zone_header_t *block;
+    size_t released = 0u;
+
+    while (map != NULL)
+    {
+        next = map->next;
+        if ((map->alloced_cnt == 0u) && (map->mapped_size <= *pad))
+        {
+            *pad -= map->mapped_size; // Kept as slack
+        }
+        else if (map->alloced_cnt == 0u)
+        {
+            bin_remove(zone, SMALL_MAP_FIRST_BLOCK(map));
+            map_unlink(zone, map);
+            released += map->mapped_size;
+            MapCache_unmap_now((void *)map, map->mapped_size);
+        }
+        map = next;
+    }
+    for (size_t bin = 0u; bin < SMALL_BIN_COUNT; bin++)
+    {
+        for (block = zone->bins[bin]; block != NULL; block = SMALL_LINKS(block)->next)
+        {
+            if (SMALL_LINKS(block)->epoch != SMALL_PURGED)
+            {
+                released += block_purge(block, pad);
+            }
+        }
+    }
+    return (released);
+}
+
+// This function prints the memory map of the small zones.
+// It prints the start address of every small zone,
+// then the start address, end address, and size of each of its blocks.
+void ZoneAllocatorSmall_report(small_zone_t *zone)
+{
+    small_map_t *current_map = zone->maps;
+    small_zone_header_t *current_header;
+
+    if (current_map == NULL)
     {
         return;
     }
-    write (1, "SMALL : ", 6);
-    print_address_as_hex((void *)small_zone_start); // Print the start address
-    write (1, "\n", 1);
-	
-	small_zone_header_t *current_header = (small_zone_header_t *)small_zone_start; // Set the current header
-	while (current_header != NULL)
-	{
-		if (current_header->used != 0u)
-		{
-			print_address_as_hex((void *)((uint8_t *)current_header + SMALL_HEADER_SIZE)); // Print the address of the block
-            write (1, " - ", 3);
-            print_address_as_hex((void *)((uint8_t *)current_header + SMALL_HEADER_SIZE + current_header->used)); // Print the end address
-            write (1, " : ", 3);
-            print_size(current_header->used); // Print the size of the block
-            write (1, "\n", 1);
-		}
-		current_header = (small_zone_header_t *)current_header->next; // Move to the next block
-	}
+    write (1, "SMALL : ", 8);
+    while (current_map != NULL)
+    {
+        print_address_as_hex((void *)current_map); // Print the start address
+        write (1, "\n", 1);
+        current_header = SMALL_MAP_FIRST_BLOCK(current_map); // Set the current header
+        while (current_header != NULL)
+        {
+            if (current_header->used != 0u)
+            {
+                print_address_as_hex((void *)((uint8_t *)current_header + SMALL_HEADER_SIZE)); // Print the address of the block
+                write (1, " - ", 3);
+                print_address_as_hex((void *)((uint8_t *)current_header + SMALL_HEADER_SIZE + current_header->used)); // Print the end address
+                write (1, " : ", 3);
+                print_size(current_header->used); // Print the size of the block
+                write (1, "\n", 1);
+            }
+            current_header = block_next(current_map, current_header); // Move to the next block
+        }
+        current_map = current_map->next;
+    }
 }
@@ -5,13 +5,32 @@
 #include <inttypes.h>
 
 #define TINY_ALLOC_SIZE (size_t)64u // Size of each allocation For best performance multiple of 16
+#define TINY_ALLOC_ALIGMENT 16u // Alignment of the tiny allocation
+#define TINY_CLASS_STEP TINY_ALLOC_ALIGMENT // Size difference between two tiny size classes
+#define TINY_CLASS_COUNT ((TINY_ALLOC_SIZE + TINY_CLASS_STEP - 1u) / TINY_CLASS_STEP) // Number of size classes
 
-void *ZoneAllocatorTiny_alloc(size_t size);
-short ZoneAllocatorTiny_free(void *ptr);
+typedef struct tiny_slab tiny_slab_t;
+
+// State of one tiny zone, every arena owns one
+typedef struct
+{
+    tiny_slab_t *partial[TINY_CLASS_COUNT]; // Slabs with at least one free slot, per class
+    tiny_slab_t *full[TINY_CLASS_COUNT]; // Slabs without free slots, per class
+    size_t empty_cnt[TINY_CLASS_COUNT]; // Number of empty slabs in the partial list, per class
+    uint8_t arena_id; // Arena registered as owner of the slabs
+} tiny_zone_t;
+
+void *ZoneAllocatorTiny_alloc(tiny_zone_t *zone, size_t size);
+size_t ZoneAllocatorTiny_alloc_batch(tiny_zone_t *zone, size_t size, size_t count, void **out);
+short ZoneAllocatorTiny_free(tiny_zone_t *zone, void *ptr);
+size_t ZoneAllocatorTiny_free_batch(tiny_zone_t *zone, void **ptrs, size_t count);
 short ZoneAllocatorTiny_realloc(void **ptr, size_t size);
 
 size_t ZoneAllocatorTiny_size_get(void *ptr);
-void ZoneAllocatorTiny_report(void);
+size_t ZoneAllocatorTiny_capacity_get(void *ptr);
+void ZoneAllocatorTiny_used_set(void *ptr, size_t size);
+size_t ZoneAllocatorTiny_trim(tiny_zone_t *zone, size_t *pad);
+void ZoneAllocatorTiny_report(tiny_zone_t *zone);
 
 
 
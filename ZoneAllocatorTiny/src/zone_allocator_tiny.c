@@ -1,181 +1,539 @@
 #include "../inc_pub/zone_allocator_tiny.h"
 #include "../../print_utils/inc_pub/print_utils.h"
+#include "../../PageMap/inc_pub/page_map.h"
+#include "../../MapCache/inc_pub/map_cache.h"
 #include <sys/mman.h>
 #include <inttypes.h>
 #include <unistd.h>
 #include <stdio.h>
 
-#define TINY_ALLOC_COUNT 100u // Number of allocations
-#define TINY_ZONE_SIZE (TINY_ALLOC_SIZE * TINY_ALLOC_COUNT) + TINY_ALLOC_COUNT  // Total size of the tiny zone
-#define TINY_ALLOC_ALIGMENT 16u // Alignment of the tiny allocation
+#define TINY_SLAB_SIZE (size_t)16384u // Size of one tiny zone (slab), multiple of the page size
+#define TINY_SLAB_SLOT_MAX (TINY_SLAB_SIZE / TINY_CLASS_STEP) // Upper bound of the slots in a slab
+#define TINY_BITMAP_WORD_BITS 64u // Slots tracked by one bitmap word
+#define TINY_BITMAP_WORDS ((TINY_SLAB_SLOT_MAX + TINY_BITMAP_WORD_BITS - 1u) / TINY_BITMAP_WORD_BITS) // Words of the occupancy bitmap
 
-uint8_t *tiny_zone_map = NULL; // Pointer to the tiny zone
-void *tiny_zone_start = NULL; // Pointer to the tiny zone
-void *tiny_zone_end = NULL; // Pointer to the tiny zone
-size_t tiny_zone_mapped_size = 0u;
-size_t tiny_alloced_cnt;
+struct tiny_slab
+{
+    tiny_slab_t *next; // Pointer to the next slab of the same list
+    tiny_slab_t *prev; // Pointer to the previous slab of the same list
+    size_t alloced_cnt; // Number of allocated slots
+    size_t mapped_size; // Used for munmap
+    size_t hint; // Bitmap word where the next free slot search starts
+    size_t class_index; // Size class served by the slab
+    size_t slot_size; // Size of one slot
+    size_t slot_count; // Number of slots
+    size_t bitmap_words; // Bitmap words covering the slots
+    uint8_t *slot_start; // First slot of the slab
+    uint64_t bitmap[TINY_BITMAP_WORDS]; // Occupancy of the slots, bit set if used
+    uint8_t map[]; // Used size of each slot, kept for size_get and the report
+};
+
+// Size class table, every value folds to a constant for a given TINY_ALLOC_SIZE
+#define TINY_CLASS_INDEX(size) (((size) - 1u) / TINY_CLASS_STEP) // Class of a requested size
+#define TINY_CLASS_SIZE(class_index) (((class_index) + 1u) * TINY_CLASS_STEP) // Slot size of a class
+#define TINY_CLASS_ALIGN(class_index) (TINY_CLASS_SIZE(class_index) & (~TINY_CLASS_SIZE(class_index) + 1u)) // Natural alignment of a class: the largest power of two dividing its slot size
+#define TINY_CLASS_SLOT_COUNT(class_index) ((TINY_SLAB_SIZE - sizeof(tiny_slab_t) - TINY_CLASS_ALIGN(class_index)) / (TINY_CLASS_SIZE(class_index) + 1u)) // Slots of a class slab, each slot also costs one size byte
+#define TINY_EMPTY_SLAB_RETAIN 1u // Number of empty slabs kept mapped per class
+
+#define SLOT_USED(slab, index) (((slab)->bitmap[(index) / TINY_BITMAP_WORD_BITS] >> ((index) % TINY_BITMAP_WORD_BITS)) & 1u) // Occupancy bit of a slot
+
+static void slab_list_add(tiny_slab_t **list, tiny_slab_t *slab)
+{
+    slab->prev = NULL;
+    slab->next = *list;
+    if (*list != NULL)
+    {
+        (*list)->prev = slab;
+    }
+    *list = slab;
+}
+
+static void slab_list_remove(tiny_slab_t **list, tiny_slab_t *slab)
+{
+    if (slab->prev == NULL)
+    {
+        *list = slab->next;
+    }
+    else
+    {
+        slab->prev->next = slab->next;
+    }
+    if (slab->next != NULL)
+    {
+        slab->next->prev = slab->prev;
+    }
+}
+
+// Maps a new slab for a size class, registers its pages and puts it on the partial list of the class.
+static tiny_slab_t *slab_new(tiny_zone_t *zone, size_t class_index)
+{
+    tiny_slab_t *slab;
+    int page_size = sysconf(_SC_PAGESIZE) ; // Get the page size
+    size_t mapped_size = TINY_SLAB_SIZE / page_size; // Calculate the number of pages
+    size_t header_size;
+
+    mapped_size = (mapped_size * page_size) + ((TINY_SLAB_SIZE % page_size == 0u) ? (0u) : ((size_t)page_size)); // Align to page size
+    slab = MapCache_map(PAGE_MAP_ZONE_TINY, mapped_size, 0, NULL);
+    if (slab == NULL)
+    {
+        return (NULL); // Allocation failed
+    }
+    if (PageMap_register(slab, mapped_size, PAGE_MAP_ZONE_TINY, zone->arena_id, slab) != 0)
+    {
+        MapCache_unmap((void *)slab, mapped_size, 0);
+        return (NULL); // Ownership could not be recorded
+    }
+    slab->alloced_cnt = 0u;
+    slab->mapped_size = mapped_size;
+    slab->hint = 0u;
+    slab->class_index = class_index;
+    slab->slot_size = TINY_CLASS_SIZE(class_index);
+    slab->slot_count = TINY_CLASS_SLOT_COUNT(class_index);
+    slab->bitmap_words = (slab->slot_count + TINY_BITMAP_WORD_BITS - 1u) / TINY_BITMAP_WORD_BITS;
+    header_size = sizeof(tiny_slab_t) + slab->slot_count; // Header and size byte of every slot
+    header_size = ((header_size + TINY_CLASS_ALIGN(class_index) - 1u) / TINY_CLASS_ALIGN(class_index)) * TINY_CLASS_ALIGN(class_index); // Slots are naturally aligned
+    slab->slot_start = (uint8_t *)slab + header_size;
+    for (size_t i = 0u; i < TINY_BITMAP_WORDS; i++)
+    {
+        slab->bitmap[i] = 0u; // A reused mapping still holds the bitmap of its previous slab
+    }
+    for (size_t i = slab->slot_count; i < slab->bitmap_words * TINY_BITMAP_WORD_BITS; i++)
+    {
+        slab->bitmap[i / TINY_BITMAP_WORD_BITS] |= (uint64_t)1u << (i % TINY_BITMAP_WORD_BITS); // Slots past the end are never free
+    }
+    slab_list_add(&zone->partial[class_index], slab);
+    zone->empty_cnt[class_index]++;
+    return (slab);
+}
+
+// Returns the slot index of ptr inside its slab, or -1 if ptr is not the start of a slot.
+static long slot_index_get(void *ptr, tiny_slab_t **slab)
+{
+    size_t offset;
+
+    *slab = PageMap_owner_get(ptr, PAGE_MAP_ZONE_TINY);
+    if (*slab == NULL)
+    {
+        return (-1); // Pointer out of range
+    }
+    if ((uint8_t *)ptr < (*slab)->slot_start)
+    {
+        return (-1); // Pointer is in the header of the slab
+    }
+    offset = (uint8_t *)ptr - (*slab)->slot_start;
+    if ((offset % (*slab)->slot_size != 0u) || (offset / (*slab)->slot_size >= (*slab)->slot_count))
+    {
+        return (-1); // Pointer not aligned
+    }
+    return ((long)(offset / (*slab)->slot_size));
+}
+
+// Claims the first free slot of a slab that is not full.
+// The search starts at the hint word and wraps around, one bitmap word at a time.
+static size_t slot_claim(tiny_slab_t *slab)
+{
+    size_t word = slab->hint;
+
+    while (slab->bitmap[word] == UINT64_MAX)
+    {
+        word++;
+        if (word == slab->bitmap_words)
+        {
+            word = 0u;
+        }
+    }
+    size_t bit = (size_t)__builtin_ctzll(~slab->bitmap[word]); // First free slot of the word
+    slab->bitmap[word] |= (uint64_t)1u << bit;
+    slab->hint = word;
+    return ((word * TINY_BITMAP_WORD_BITS) + bit);
+}
 
 // Allocates a block of memory of the given size.
-void *ZoneAllocatorTiny_alloc(size_t size)
+// The size is rounded up to its class and served from a slab of that class.
+void *ZoneAllocatorTiny_alloc(tiny_zone_t *zone, size_t size)
 {
-    if (size == 0)
+    tiny_slab_t *slab;
+    size_t class_index;
+
+    if ((size == 0) || (size > TINY_ALLOC_SIZE))
     {
         return (0);
     }
 
-    if (tiny_zone_map == NULL)
+    class_index = TINY_CLASS_INDEX(size);
+    slab = zone->partial[class_index];
+    if (slab == NULL)
     {
-        int page_size = sysconf(_SC_PAGESIZE) ; // Get the page size
-        tiny_zone_mapped_size= TINY_ZONE_SIZE / page_size; // Calculate the number of aligned blocks
-        tiny_zone_mapped_size = (tiny_zone_mapped_size * page_size) + ((TINY_ZONE_SIZE % page_size == 0u) ? (0u) : (page_size)); // Align to page size
-        tiny_zone_map = mmap(NULL, tiny_zone_mapped_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
-        if (tiny_zone_map == MAP_FAILED)
+        slab = slab_new(zone, class_index);
+        if (slab == NULL)
         {
-            return NULL; // Allocation failed
+            return (NULL);
         }
-        uint8_t aligned_count = TINY_ALLOC_COUNT / TINY_ALLOC_ALIGMENT; // Calculate the number of aligned blocks
-        aligned_count = (aligned_count * TINY_ALLOC_ALIGMENT) + ((TINY_ALLOC_COUNT % TINY_ALLOC_ALIGMENT == 0u) ? (0u) : (TINY_ALLOC_ALIGMENT)); // Align to 16
-        tiny_zone_start = tiny_zone_map + aligned_count; // Set the start pointer
-        tiny_zone_end = tiny_zone_start + TINY_ALLOC_SIZE * TINY_ALLOC_COUNT; // Set the end pointer
-        tiny_alloced_cnt = 0u;
     }
 
-    for(uint8_t i = 0u; i < TINY_ALLOC_COUNT; i++)
+    size_t i = slot_claim(slab);
+    slab->map[i] = size; // Keep the size of the block
+    if (slab->alloced_cnt == 0u)
+    {
+        zone->empty_cnt[class_index]--;
+    }
+    slab->alloced_cnt++;
+    if (slab->alloced_cnt == slab->slot_count)
+    {
+        slab_list_remove(&zone->partial[class_index], slab);
+        slab_list_add(&zone->full[class_index], slab);
+    }
+    return ((void *)(slab->slot_start + (i * slab->slot_size))); // Return the pointer to the allocated memory
+}
+
+// Allocates count blocks of size bytes into out, claiming the free slots of a bitmap word with one store.
+// A slab updates its counter and its lists once for all the slots taken from it.
+// Returns the number of blocks allocated, less than count only if no slab could be mapped.
+size_t ZoneAllocatorTiny_alloc_batch(tiny_zone_t *zone, size_t size, size_t count, void **out)
+{
+    tiny_slab_t *slab;
+    size_t class_index;
+    size_t done = 0u;
+    size_t take;
+    size_t word;
+    size_t index;
+    uint64_t free_bits;
+    uint64_t claimed;
+
+    if ((size == 0) || (size > TINY_ALLOC_SIZE))
+    {
+        return (0);
+    }
+
+    class_index = TINY_CLASS_INDEX(size);
+    while (done < count)
     {
-        if ((tiny_zone_map[i]) == 0u)
+        slab = zone->partial[class_index];
+        if (slab == NULL)
+        {
+            slab = slab_new(zone, class_index);
+            if (slab == NULL)
+            {
+                break;
+            }
+        }
+        if (slab->alloced_cnt == 0u)
         {
-            tiny_zone_map[i] = size; // Mark the block as used
-            tiny_alloced_cnt++;
-            void * ret = (void *)((uint8_t *)tiny_zone_start + ((size_t)i * TINY_ALLOC_SIZE));
-            return ((void *)((uint8_t *)tiny_zone_start + ((size_t)i * TINY_ALLOC_SIZE))); // Return the pointer to the allocated memory
+            zone->empty_cnt[class_index]--;
+        }
+        take = slab->slot_count - slab->alloced_cnt; // Free slots of the slab, the word scan below finds all of them
+        take = (take < count - done) ? (take) : (count - done);
+        slab->alloced_cnt += take;
+        word = slab->hint;
+        while (take != 0u)
+        {
+            free_bits = ~slab->bitmap[word];
+            claimed = 0u;
+            while ((free_bits != 0u) && (take != 0u))
+            {
+                index = (size_t)__builtin_ctzll(free_bits);
+                free_bits &= free_bits - 1u; // Next free slot of the word
+                claimed |= (uint64_t)1u << index;
+                index += word * TINY_BITMAP_WORD_BITS;
+                slab->map[index] = size; // Keep the size of the block
+                out[done++] = (void *)(slab->slot_start + (index * slab->slot_size));
+                take--;
+            }
+            slab->bitmap[word] |= claimed;
+            slab->hint = word;
+            word = (word + 1u == slab->bitmap_words) ? (0u) : (word + 1u);
+        }
+        if (slab->alloced_cnt == slab->slot_count)
+        {
+            slab_list_remove(&zone->partial[class_index], slab);
+            slab_list_add(&zone->full[class_index], slab);
         }
     }
-
-    return (NULL);
+    return (done);
 }
 
 size_t ZoneAllocatorTiny_size_get(void *ptr)
 {
     size_t ret = 0;
+    tiny_slab_t *slab;
+    long index;
 
     if (ptr == NULL)
     {
         ret = 0; // Invalid pointer
     }
-    else if (ptr < tiny_zone_start || ptr > tiny_zone_end)
+    else
+    {
+        index = slot_index_get(ptr, &slab);
+        if (index >= 0)
+        {
+            ret = slab->map[index]; // Return the size of the block
+        }
+    }
+    return (ret);
+}
+
+// Returns the size of the slot of ptr, the block can grow up to it in place.
+// Returns 0 if ptr is not an allocated slot. The size byte of the slot is read, not the bitmap word
+// other slots share, so the owner of the block may call it without the arena lock.
+size_t ZoneAllocatorTiny_capacity_get(void *ptr)
+{
+    tiny_slab_t *slab;
+    long index;
+
+    if (ptr == NULL)
     {
-        ret = 0; // Pointer out of range
+        return (0);
     }
-    else if (ptr == tiny_zone_map)
+    index = slot_index_get(ptr, &slab);
+    if ((index < 0) || (slab->map[index] == 0u))
     {
-        ret =  0; // Pointer is the map of the zone
+        return (0); // Out of range, not aligned or not allocated
     }
-    else
+    return (slab->slot_size);
+}
+
+// Records a new used size for an allocated block that fits its slot.
+// Only the size byte of the slot is written, so the owner of the block may call it without the arena lock.
+void ZoneAllocatorTiny_used_set(void *ptr, size_t size)
+{
+    tiny_slab_t *slab;
+    long index = slot_index_get(ptr, &slab);
+
+    if ((index >= 0) && (size <= slab->slot_size))
+    {
+        slab->map[index] = size;
+    }
+}
+
+// Updates a slab once freed slots of it were cleared from its bitmap: a full slab goes back to the partial list,
+// and an empty slab is given back to the system unless it is needed to keep TINY_EMPTY_SLAB_RETAIN slabs of its class around.
+static void slab_slots_freed(tiny_zone_t *zone, tiny_slab_t *slab, size_t freed)
+{
+    size_t class_index = slab->class_index; // Class recovered from the slab header
+
+    if (slab->alloced_cnt == slab->slot_count)
     {
-        uint8_t index = ((uint8_t*)ptr - (uint8_t *)tiny_zone_start) / TINY_ALLOC_SIZE; // Calculate the index of the block
-        if (index * TINY_ALLOC_SIZE + (uint8_t *)tiny_zone_start != (uint8_t *)ptr)
+        slab_list_remove(&zone->full[class_index], slab);
+        slab_list_add(&zone->partial[class_index], slab);
+    }
+    slab->alloced_cnt -= freed;
+    if (slab->alloced_cnt == 0u)
+    {
+        if (zone->empty_cnt[class_index] < TINY_EMPTY_SLAB_RETAIN)
         {
-            ret = 0; // Pointer not aligned
+            zone->empty_cnt[class_index]++;
         }
         else
         {
-            ret = tiny_zone_map[index]; // Return the size of the block
+            slab_list_remove(&zone->partial[class_index], slab);
+            PageMap_unregister(slab, slab->mapped_size);
+            MapCache_unmap((void *)slab, slab->mapped_size, 0);
         }
     }
-    return (ret);
 }
 
 // Frees the memory block pointed to by ptr.
-short ZoneAllocatorTiny_free(void *ptr)
+short ZoneAllocatorTiny_free(tiny_zone_t *zone, void *ptr)
 {
     short ret = 0;
+    tiny_slab_t *slab;
+    long index;
+
     if (ptr == NULL)
     {
         ret = -1; // Invalid pointer
     }
-    else if (ptr < tiny_zone_start || ptr > tiny_zone_end)
-    {
-        ret = -2; // Pointer out of range
-    }
     else
     {
-        uint8_t index = ((uint8_t*)ptr - (uint8_t *)tiny_zone_start) / TINY_ALLOC_SIZE; // Calculate the index of the block
-        if (index * TINY_ALLOC_SIZE + (uint8_t *)tiny_zone_start != (uint8_t *)ptr)
+        index = slot_index_get(ptr, &slab);
+        if (index < 0)
+        {
+            ret = -2; // Pointer out of range or not aligned
+        }
+        else if (SLOT_USED(slab, index) == 0u)
         {
-            ret = -2; // Pointer not aligned
+            ret = -2; // Block is not allocated
         }
         else  // Free the block
         {
-            tiny_zone_map[index] = 0u; // Mark the block as free
-            tiny_alloced_cnt--;
-            if (tiny_alloced_cnt == 0u)
+            slab->bitmap[index / TINY_BITMAP_WORD_BITS] &= ~((uint64_t)1u << (index % TINY_BITMAP_WORD_BITS)); // Mark the block as free
+            slab->map[index] = 0u;
+            slab->hint = index / TINY_BITMAP_WORD_BITS; // Reuse the slot while it is still in cache
+            slab_slots_freed(zone, slab, 1u);
+        }
+    }
+    return (ret);
+}
+
+// Frees the blocks of ptrs. The blocks of one slab that come in a row, in any order, are freed together:
+// the slab of a row is looked up once, the bits of one bitmap word are cleared with one store,
+// and the lists and the empty slab policy are applied once per row.
+// Pointers that are not allocated slots are skipped. Returns the number of blocks freed.
+size_t ZoneAllocatorTiny_free_batch(tiny_zone_t *zone, void **ptrs, size_t count)
+{
+    tiny_slab_t *slab;
+    uint8_t *slot_end;
+    uint64_t mask;
+    uint64_t bit;
+    size_t word;
+    size_t freed = 0u;
+    size_t row;
+    size_t i = 0u;
+    long index;
+
+    while (i < count)
+    {
+        index = (ptrs[i] == NULL) ? (-1) : (slot_index_get(ptrs[i], &slab));
+        if ((index < 0) || (SLOT_USED(slab, index) == 0u))
+        {
+            i++;
+            continue; // Not an allocated slot
+        }
+        slot_end = slab->slot_start + (slab->slot_count * slab->slot_size);
+        word = (size_t)index / TINY_BITMAP_WORD_BITS;
+        slab->hint = word; // Reuse the slots while they are still in cache
+        mask = 0u;
+        row = 0u;
+        while (1)
+        {
+            bit = (uint64_t)1u << ((size_t)index % TINY_BITMAP_WORD_BITS);
+            if ((slab->bitmap[word] & ~mask & bit) != 0u) // Allocated and not seen twice
             {
-                munmap((void *)tiny_zone_map, tiny_zone_mapped_size);
-                tiny_zone_mapped_size = 0u;
-                tiny_zone_map = NULL;
+                mask |= bit;
+                slab->map[index] = 0u;
+                row++;
             }
+            i++;
+            if ((i == count) || ((uint8_t *)ptrs[i] < slab->slot_start) || ((uint8_t *)ptrs[i] >= slot_end)
+                || (((size_t)((uint8_t *)ptrs[i] - slab->slot_start) % slab->slot_size) != 0u))
+            {
+                break; // Next pointer is in another slab or not a slot, looked up again
+            }
+            index = (long)(((uint8_t *)ptrs[i] - slab->slot_start) / slab->slot_size);
+            if ((size_t)index / TINY_BITMAP_WORD_BITS != word)
+            {
+                slab->bitmap[word] &= ~mask;
+                word = (size_t)index / TINY_BITMAP_WORD_BITS;
+                mask = 0u;
+            }
+        }
+        slab->bitmap[word] &= ~mask;
+        if (row != 0u)
+        {
+            freed += row;
+            slab_slots_freed(zone, slab, row);
         }
     }
-    return (ret);
+    return (freed);
 }
 
-// This function only performs a realocation if the pointer is valid and the size is valid for the tiny zone.
-// It checks if the pointer is in the tiny zone.
+// This function only performs an in place realocation if the pointer is valid and the new size fits the slot.
+// It returns 0 on success, otherwise the block is left untouched and the caller has to move it.
 short ZoneAllocatorTiny_realloc(void **ptr, size_t size)
 {
     short ret = -1;
+    tiny_slab_t *slab;
+    long index;
 
-    if (ptr == NULL)
-    {
-        *ptr = NULL; // Invalid pointer
-    }
-    else if (*ptr < tiny_zone_start || *ptr > tiny_zone_end)
+    if ((ptr == NULL) || (*ptr == NULL))
     {
-        *ptr = NULL; // Pointer out of range
+        ret = -1; // Invalid pointer
     }
     else if ((size == 0) || (size > TINY_ALLOC_SIZE))
     {
-        ret = ZoneAllocatorTiny_free(*ptr);
-        *ptr =  NULL; // Invalid size
+        ret = -1; // Invalid size
     }
     else
     {
-        uint8_t index = ((uint8_t*)*ptr - (uint8_t *)tiny_zone_start) / TINY_ALLOC_SIZE; // Calculate the index of the block
-        if (index * TINY_ALLOC_SIZE + (uint8_t *)tiny_zone_start != (uint8_t *)*ptr)
+        index = slot_index_get(*ptr, &slab);
+        if ((index < 0) || (SLOT_USED(slab, index) == 0u))
         {
-            *ptr = NULL; // Pointer not aligned
+            ret = -2; // Pointer out of range, not aligned or not allocated
         }
-        else 
+        else if (size > slab->slot_size)
+        {
+            ret = -1; // Does not fit the class of the slab
+        }
+        else
         {
             ret = 0;
-            tiny_zone_map[index] = size;
+            slab->map[index] = size;
         }
     }
     return (ret);
 }
 
-// This function prints the memory map of the tiny zone.
-// It prints the start address, end address, and size of each block.
-// It also prints the start address of the tiny zone.
-void ZoneAllocatorTiny_report(void)
+// Unmaps the empty slabs kept for reuse, the first ones that fit the slack left in pad are kept and taken from it.
+// Only the partial lists are walked, empty slabs are never full.
+// Returns the number of bytes released.
+size_t ZoneAllocatorTiny_trim(tiny_zone_t *zone, size_t *pad)
 {
-    if (tiny_zone_map == NULL)
+    tiny_slab_t *slab;
+    tiny_slab_t *next;
+    size_t released = 0u;
+
+    for (size_t class_index = 0u; class_index < TINY_CLASS_COUNT; class_index++)
     {
-        return;
+        for (slab = zone->partial[class_index]; (slab != NULL) && (zone->empty_cnt[class_index] != 0u); slab = next)
+        {
+            next = slab->next;
+            if (slab->alloced_cnt != 0u)
+            {
+                continue;
+            }
+            if (slab->mapped_size <= *pad)
+            {
+                *pad -= slab->mapped_size; // Kept as slack
+                continue;
+            }
+            slab_list_remove(&zone->partial[class_index], slab);
+            zone->empty_cnt[class_index]--;
+            PageMap_unregister(slab, slab->mapped_size);
+            released += slab->mapped_size;
+            MapCache_unmap_now((void *)slab, slab->mapped_size);
+        }
     }
-    write (1, "TINY : ", 6);
-    print_address_as_hex(tiny_zone_map); // Print the start address
+    return (released);
+}
+
+static void slab_report(tiny_slab_t *slab)
+{
+    write (1, "TINY : ", 7);
+    print_address_as_hex(slab); // Print the start address
     write (1, "\n", 1);
-    for (uint8_t i = 0u; i < TINY_ALLOC_COUNT; i++)
+    for (size_t i = 0u; i < slab->slot_count; i++)
     {
-        if (tiny_zone_map[i] != 0u)
+        if (SLOT_USED(slab, i) != 0u)
         {
-            print_address_as_hex((void *)((size_t)tiny_zone_start + (i * TINY_ALLOC_SIZE))); // Print the address of the block
+            print_address_as_hex((void *)(slab->slot_start + (i * slab->slot_size))); // Print the address of the block
             write (1, " - ", 3);
-            print_address_as_hex((void *)(((size_t)tiny_zone_start + (i * TINY_ALLOC_SIZE) + tiny_zone_map[i]))); // Print the end address
+            print_address_as_hex((void *)(slab->slot_start + (i * slab->slot_size) + slab->map[i])); // Print the end address
             write (1, " : ", 3);
-            print_size(tiny_zone_map[i]); // Print the size of the block
+            print_size(slab->map[i]); // Print the size of the block
             write (1, "\n", 1);
         }
     }
 }
+
+// This function prints the memory map of the tiny zone.
+// It prints the start address of each slab, then the start address, end address, and size of each block.
+void ZoneAllocatorTiny_report(tiny_zone_t *zone)
+{
+    tiny_slab_t *slab;
+
+    for (size_t class_index = 0u; class_index < TINY_CLASS_COUNT; class_index++)
+    {
+        for (slab = zone->partial[class_index]; slab != NULL; slab = slab->next)
+        {
+            if (slab->alloced_cnt != 0u)
+            {
+                slab_report(slab);
+            }
+        }
+        for (slab = zone->full[class_index]; slab != NULL; slab = slab->next)
+        {
+            slab_report(slab);
+        }
+    }
+}
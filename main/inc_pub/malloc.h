@@ -5,9 +5,49 @@
 
 // Function declarations and public interfaces for malloc module
 
+#define FT_MALLOC_ALIGNMENT 16u // Alignment of every block, ft_aligned_alloc hands out larger ones
+
+// Parameters of ft_mallopt
+#define FT_M_TCACHE_COUNT 1 // Blocks kept per thread cache bin, 0 disables the thread cache
+#define FT_M_REMOTE_FREE 2 // 1 queues frees of blocks owned by another arena, 0 locks the owning arena instead
+#define FT_M_MMAP_THRESHOLD 3 // Requests from this size on get a mapping of their own, at least 64 KB
+#define FT_M_RETAIN_BUDGET 4 // Bytes of empty zone mappings kept for reuse, 0 unmaps them at once
+#define FT_M_RETAIN_DECAY_MS 5 // Milliseconds an empty zone mapping is kept for reuse
+#define FT_M_PURGE_INTERVAL_MS 6 // Milliseconds between two purges of a background thread, 0 stops the thread
+#define FT_M_HUGE_PAGES 7 // 1 maps the big zones and the grown small zones with 2 MB huge pages, 0 with regular pages
+
+// Counters returned by ft_malloc_stats_get
+typedef struct
+{
+    size_t tcache_hits; // Allocations served by a thread cache
+    size_t tcache_misses; // Allocations that refilled a thread cache bin from the zones
+    size_t tcache_flushes; // Frees that flushed a full thread cache bin to the zones
+    size_t retained_bytes; // Bytes of empty zone mappings kept for reuse
+} ft_malloc_stats_t;
+
+typedef struct ft_arena ft_arena_t; // Bump allocation arena, see ft_arena_create
+
 void *ft_malloc(size_t size);
+void *ft_calloc(size_t count, size_t size);
+void *ft_aligned_alloc(size_t alignment, size_t size);
+int ft_posix_memalign(void **memptr, size_t alignment, size_t size);
 void *ft_realloc(void* ptr, size_t size);
 void ft_free(void* ptr);
+void ft_free_sized(void* ptr, size_t size);
+size_t ft_malloc_usable_size(void *ptr);
+size_t ft_malloc_batch(size_t size, size_t count, void **out);
+void ft_free_batch(void **ptrs, size_t count);
+
+ft_arena_t *ft_arena_create(size_t chunk_size, int keep_chunks);
+void *ft_arena_alloc(ft_arena_t *arena, size_t size);
+void ft_arena_reset(ft_arena_t *arena);
+void ft_arena_destroy(ft_arena_t *arena);
+
+int ft_mallopt(int param, int value);
+void ft_malloc_stats_get(ft_malloc_stats_t *stats);
+size_t ft_malloc_purge(void);
+size_t ft_malloc_trim(size_t pad);
+void ft_malloc_report(void);
 
 
 #endif // MALLOC_H
\ No newline at end of file
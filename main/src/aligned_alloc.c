@@ -0,0 +1,77 @@
+#include "../../ZoneAllocatorTiny/inc_pub/zone_allocator_tiny.h"
+#include "../../ZoneAllocatorBig/inc_pub/zone_allocator_big.h"
+#include "../../ZoneAllocatorHuge/inc_pub/zone_allocator_huge.h"
+#include "../../Arena/inc_pub/arena.h"
+#include "../inc_pub/malloc.h"
+#include <stddef.h>
+#include <errno.h>
+#include <unistd.h>
+
+// Allocates size bytes starting on a multiple of alignment, a power of two. Returns NULL for any other alignment.
+// Size 0 is served as size 1.
+// Every block is 16 byte aligned already. Tiny slots are naturally aligned, so a request rounded up to a multiple
+// of the alignment that still fits a tiny class takes a slot of that class.
+// Larger requests get an aligned block of the big zone, the slack in front of it stays free for other requests.
+// Huge requests and alignments above the page size get a mapping of their own.
+// The thread cache is bypassed, its bins mix tiny and small blocks of the same capacity.
+void *ft_aligned_alloc(size_t alignment, size_t size)
+{
+    const size_t page_size = (size_t)sysconf(_SC_PAGESIZE); // Get the page size
+    size_t rounded;
+    arena_t *arena;
+    void *ptr = NULL;
+
+    if ((alignment == 0u) || ((alignment & (alignment - 1u)) != 0u))
+    {
+        return (NULL); // Not a power of two
+    }
+    size = (size == 0u) ? (1u) : (size); // A unique block that can be freed, as posix_memalign has to succeed for size 0
+    if (alignment <= FT_MALLOC_ALIGNMENT)
+    {
+        return (ft_malloc(size));
+    }
+    if ((size >= ZoneAllocatorHuge_threshold_get()) || (alignment > page_size))
+    {
+        return (ZoneAllocatorHuge_aligned_alloc(size, alignment));
+    }
+    rounded = ((size + alignment - 1u) / alignment) * alignment; // A multiple of the alignment, its class is aligned to it
+
+    arena = Arena_thread_get();
+    Arena_lock(arena);
+    Arena_remote_drain(arena);
+    if (rounded <= TINY_ALLOC_SIZE)
+    {
+        ptr = ZoneAllocatorTiny_alloc(&arena->tiny, rounded);
+        if (ptr != NULL)
+        {
+            ZoneAllocatorTiny_used_set(ptr, size);
+        }
+    }
+
+    if (ptr == NULL)
+    {
+        ptr = ZoneAllocatorBig_aligned_alloc(&arena->big, size, alignment);
+    }
+    Arena_unlock(arena);
+    return (ptr);
+}
+
+// Stores in memptr a block of size bytes starting on a multiple of alignment.
+// Returns 0 on success, EINVAL if alignment is not a power of two multiple of sizeof(void *), ENOMEM if no memory is left.
+// memptr is left untouched on failure.
+int ft_posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    void *ptr;
+
+    if ((alignment < sizeof(void *)) || ((alignment & (alignment - 1u)) != 0u))
+    {
+        return (EINVAL);
+    }
+    ptr = ft_aligned_alloc(alignment, size);
+    if (ptr == NULL)
+    {
+        return (ENOMEM);
+    }
+    *memptr = ptr;
+    return (0);
+}
@@ -0,0 +1,147 @@
+#include "../../ZoneAllocatorTiny/inc_pub/zone_allocator_tiny.h"
+#include "../../ZoneAllocatorSmall/inc_pub/zone_allocator_small.h"
+#include "../../ZoneAllocatorBig/inc_pub/zone_allocator_big.h"
+#include "../../ZoneAllocatorHuge/inc_pub/zone_allocator_huge.h"
+#include "../../PageMap/inc_pub/page_map.h"
+#include "../../VirtualRegion/inc_pub/virtual_region.h"
+#include "../../Arena/inc_pub/arena.h"
+#include "../inc_pub/malloc.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <unistd.h>
+
+// Allocates count blocks of size bytes and stores them in out.
+// Tiny slots and small blocks are claimed in one pass over the zone metadata under one lock of the arena,
+// big and huge blocks one at a time. The thread cache is not used: the batch already amortizes the lock.
+// Returns the number of blocks allocated, they are the first ones of out. It is less than count only when memory runs out.
+size_t ft_malloc_batch(size_t size, size_t count, void **out)
+{
+    arena_t *arena;
+    void *ptr;
+    size_t done = 0u;
+
+    if ((out == NULL) || (size == 0u))
+    {
+        return (0);
+    }
+    if (size >= ZoneAllocatorHuge_threshold_get())
+    {
+        while ((done < count) && ((ptr = ZoneAllocatorHuge_alloc(size)) != NULL))
+        {
+            out[done++] = ptr; // One mapping each, no arena involved
+        }
+        return (done);
+    }
+
+    arena = Arena_thread_get();
+    Arena_lock(arena);
+    Arena_remote_drain(arena);
+    if (size <= TINY_ALLOC_SIZE)
+    {
+        done = ZoneAllocatorTiny_alloc_batch(&arena->tiny, size, count, out);
+    }
+
+    if ((done < count) && (size <= SMALL_ALLOC_SIZE_MAX))
+    {
+        done += ZoneAllocatorSmall_alloc_batch(&arena->small, size, count - done, out + done);
+    }
+
+    while ((done < count) && ((ptr = ZoneAllocatorBig_alloc(&arena->big, size)) != NULL))
+    {
+        out[done++] = ptr;
+    }
+    Arena_unlock(arena);
+    return (done);
+}
+
+// Returns the end of the row of blocks of one zone of one arena starting at ptrs[start].
+// The zone and arena of a block are only looked up when it is not on the page of the previous block.
+static size_t row_end(void **ptrs, size_t start, size_t count, uint8_t zone, uint8_t arena_id)
+{
+    const uintptr_t page_mask = ~((uintptr_t)sysconf(_SC_PAGESIZE) - 1u);
+    size_t i;
+
+    for (i = start + 1u; i < count; i++)
+    {
+        if ((((uintptr_t)ptrs[i] & page_mask) != ((uintptr_t)ptrs[i - 1u] & page_mask))
+            && ((VirtualRegion_zone_get(ptrs[i]) != zone) || (PageMap_arena_get(ptrs[i]) != arena_id)))
+        {
+            break;
+        }
+    }
+    return (i);
+}
+
+// Frees a row of blocks of one zone of the arena, the arena lock must be held.
+static void row_free(arena_t *arena, uint8_t zone, void **ptrs, size_t count)
+{
+    switch (zone)
+    {
+        case PAGE_MAP_ZONE_TINY:
+            ZoneAllocatorTiny_free_batch(&arena->tiny, ptrs, count);
+            break;
+        case PAGE_MAP_ZONE_SMALL:
+            ZoneAllocatorSmall_free_batch(&arena->small, ptrs, count);
+            break;
+        default:
+            for (size_t i = 0u; i < count; i++)
+            {
+                ZoneAllocatorBig_free(&arena->big, ptrs[i]);
+            }
+            break;
+    }
+}
+
+// Frees count blocks of ptrs, NULL entries are skipped.
+// The blocks are taken in rows of one zone of one arena, in the order of the array: the tiny zone clears the slots
+// of a slab together and the small zone merges the neighbor blocks of a row before binning them.
+// The blocks of ft_malloc_batch come grouped by slab and in address order, other orders still work, in shorter rows.
+// An arena is locked once for the rows of its blocks that follow each other in the array.
+// Blocks of another arena are freed under its lock, not queued on its remote list.
+void ft_free_batch(void **ptrs, size_t count)
+{
+    arena_t *arena;
+    uint8_t zone;
+    uint8_t arena_id;
+    size_t i = 0u;
+    size_t end;
+
+    if (ptrs == NULL)
+    {
+        return;
+    }
+    while (i < count)
+    {
+        if (ptrs[i] == NULL)
+        {
+            i++;
+            continue;
+        }
+        zone = VirtualRegion_zone_get(ptrs[i]);
+        if (zone == PAGE_MAP_ZONE_NONE)
+        {
+            ZoneAllocatorHuge_free(ptrs[i]); // Huge blocks are not in the page map, anything else is not ours
+            i++;
+            continue;
+        }
+        arena_id = PageMap_arena_get(ptrs[i]);
+        arena = Arena_get(arena_id);
+        Arena_lock(arena);
+        while (1)
+        {
+            end = row_end(ptrs, i, count, zone, arena_id);
+            row_free(arena, zone, ptrs + i, end - i);
+            i = end;
+            if ((i == count) || (ptrs[i] == NULL))
+            {
+                break;
+            }
+            zone = VirtualRegion_zone_get(ptrs[i]);
+            if ((zone == PAGE_MAP_ZONE_NONE) || (PageMap_arena_get(ptrs[i]) != arena_id))
+            {
+                break; // Next block is huge or of another arena
+            }
+        }
+        Arena_unlock(arena);
+    }
+}
@@ -0,0 +1,40 @@
+#include "../../BumpArena/inc_pub/bump_arena.h"
+#include "../inc_pub/malloc.h"
+#include <stddef.h>
+
+// Creates an arena for temporaries that all die together: allocations bump a pointer in chunks of chunk_size bytes,
+// 0 for the default, taken from the big zone of the calling thread's arena, where ft_malloc_report shows them.
+// If keep_chunks is set ft_arena_reset keeps the chunks for the next use, otherwise it gives them back.
+// An arena is used by one thread at a time. Returns NULL if the first chunk could not be allocated.
+ft_arena_t *ft_arena_create(size_t chunk_size, int keep_chunks)
+{
+    return ((ft_arena_t *)BumpArena_create(chunk_size, (keep_chunks != 0) ? (1) : (0)));
+}
+
+// Allocates size bytes aligned to FT_MALLOC_ALIGNMENT. The block is not freed on its own, only by a reset or the destroy.
+void *ft_arena_alloc(ft_arena_t *arena, size_t size)
+{
+    if (arena == NULL)
+    {
+        return (NULL);
+    }
+    return (BumpArena_alloc((bump_arena_t *)arena, size));
+}
+
+// Frees every block of the arena at once, in one step per chunk.
+void ft_arena_reset(ft_arena_t *arena)
+{
+    if (arena != NULL)
+    {
+        BumpArena_reset((bump_arena_t *)arena);
+    }
+}
+
+// Frees every block and chunk of the arena, and the arena itself.
+void ft_arena_destroy(ft_arena_t *arena)
+{
+    if (arena != NULL)
+    {
+        BumpArena_destroy((bump_arena_t *)arena);
+    }
+}
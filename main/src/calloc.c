@@ -0,0 +1,62 @@
+#include "../../ZoneAllocatorTiny/inc_pub/zone_allocator_tiny.h"
+#include "../../ZoneAllocatorSmall/inc_pub/zone_allocator_small.h"
+#include "../../ZoneAllocatorBig/inc_pub/zone_allocator_big.h"
+#include "../../ZoneAllocatorHuge/inc_pub/zone_allocator_huge.h"
+#include "../../Arena/inc_pub/arena.h"
+#include "../../ThreadCache/inc_pub/thread_cache.h"
+#include "../inc_pub/malloc.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Allocates count * size bytes that read as zero, NULL if the product overflows.
+// Only memory that may hold old data is cleared: a huge block is a new mapping and the small and big zones
+// skip the pages of purged blocks and of new maps, so a large zeroed block costs no page write up front.
+// Blocks of the thread cache and of the tiny zone are always cleared, they are at most a few cache lines.
+void *ft_calloc(size_t count, size_t size)
+{
+    arena_t *arena;
+    void *ptr = NULL;
+
+    if ((size != 0u) && (count > SIZE_MAX / size))
+    {
+        return (NULL); // count * size overflows
+    }
+    size *= count;
+    if (size >= ZoneAllocatorHuge_threshold_get())
+    {
+        return (ZoneAllocatorHuge_alloc(size)); // A new mapping, already zero
+    }
+    if (size <= THREAD_CACHE_SIZE_MAX)
+    {
+        ptr = ThreadCache_alloc(size);
+        if (ptr != NULL)
+        {
+            return (memset(ptr, 0, size));
+        }
+    }
+
+    arena = Arena_thread_get();
+    Arena_lock(arena);
+    Arena_remote_drain(arena);
+    if (size <= TINY_ALLOC_SIZE)
+    {
+        ptr = ZoneAllocatorTiny_alloc(&arena->tiny, size);
+        if (ptr != NULL)
+        {
+            memset(ptr, 0, size);
+        }
+    }
+
+    if ((ptr == NULL) && (size <= SMALL_ALLOC_SIZE_MAX))
+    {
+        ptr = ZoneAllocatorSmall_calloc(&arena->small, size);
+    }
+
+    if (ptr == NULL)
+    {
+        ptr = ZoneAllocatorBig_calloc(&arena->big, size);
+    }
+    Arena_unlock(arena);
+    return (ptr);
+}
@@ -0,0 +1,44 @@
+#include "../../Arena/inc_pub/arena.h"
+#include "../../MapCache/inc_pub/map_cache.h"
+#include "../../VirtualRegion/inc_pub/virtual_region.h"
+#include "../../ZoneAllocatorHuge/inc_pub/zone_allocator_huge.h"
+#include "../../Purger/inc_pub/purger.h"
+#include <pthread.h>
+
+// A fork copies the locks as they are, one held by another thread would never be released in the child.
+// Every lock is taken before the fork and released after it in both processes,
+// in the order the allocation paths nest them: the purger lock may be held while a thread is created,
+// an arena lock while a zone maps memory.
+
+static void fork_prepare(void)
+{
+    Purger_fork_lock();
+    Arena_fork_lock();
+    MapCache_fork_lock();
+    VirtualRegion_fork_lock();
+    ZoneAllocatorHuge_fork_lock();
+}
+
+static void fork_parent(void)
+{
+    ZoneAllocatorHuge_fork_unlock();
+    VirtualRegion_fork_unlock();
+    MapCache_fork_unlock();
+    Arena_fork_unlock();
+    Purger_fork_unlock(0);
+}
+
+static void fork_child(void)
+{
+    ZoneAllocatorHuge_fork_unlock();
+    VirtualRegion_fork_unlock();
+    MapCache_fork_unlock();
+    Arena_fork_unlock();
+    Purger_fork_unlock(1);
+}
+
+// Registered when the program or the library is loaded, before any thread of it can fork.
+__attribute__((constructor)) static void fork_handlers_register(void)
+{
+    pthread_atfork(fork_prepare, fork_parent, fork_child);
+}
@@ -1,19 +1,73 @@
 #include "../../ZoneAllocatorTiny/inc_pub/zone_allocator_tiny.h"
 #include "../../ZoneAllocatorSmall/inc_pub/zone_allocator_small.h"
 #include "../../ZoneAllocatorBig/inc_pub/zone_allocator_big.h"
+#include "../../ZoneAllocatorHuge/inc_pub/zone_allocator_huge.h"
+#include "../../PageMap/inc_pub/page_map.h"
+#include "../../VirtualRegion/inc_pub/virtual_region.h"
+#include "../../Arena/inc_pub/arena.h"
+#include "../../ThreadCache/inc_pub/thread_cache.h"
 #include <stddef.h>
 
+// The block is given back to the arena that allocated it, whatever thread frees it.
+// A thread of another arena does not take the arena lock, it pushes the block on the remote list.
 void ft_free(void* ptr)
 {
-    short ret;
-    
-    ret = ZoneAllocatorTiny_free(ptr);
-    if (ret != 0)
+    uint8_t zone;
+    arena_t *arena;
+
+    if (ptr == NULL)
+    {
+        return;
+    }
+
+    zone = VirtualRegion_zone_get(ptr);
+    if (zone == PAGE_MAP_ZONE_NONE)
+    {
+        ZoneAllocatorHuge_free(ptr); // Huge blocks are not in the page map, anything else is not ours
+        return;
+    }
+    if (ThreadCache_free(ptr, zone) != -1)
+    {
+        return; // Kept by the thread cache, or not an allocated block
+    }
+    arena = Arena_get(PageMap_arena_get(ptr));
+    if (Arena_remote_free(arena, ptr) == 0)
+    {
+        return; // Freed by its arena on its next allocation
+    }
+    Arena_lock(arena);
+    Arena_block_free(arena, ptr, zone);
+    Arena_unlock(arena);
+}
+
+// Frees ptr knowing its size: any size from the one asked for up to ft_malloc_usable_size(ptr).
+// The zone still comes from the address, a few compares, and a tiny or small block goes to the thread cache bin of size.
+void ft_free_sized(void* ptr, size_t size)
+{
+    uint8_t zone;
+    arena_t *arena;
+
+    if (ptr == NULL)
+    {
+        return;
+    }
+
+    zone = VirtualRegion_zone_get(ptr);
+    if (zone == PAGE_MAP_ZONE_NONE)
+    {
+        ZoneAllocatorHuge_free(ptr);
+        return;
+    }
+    if (ThreadCache_free_sized(ptr, zone, size) != -1)
     {
-        ret = ZoneAllocatorSmall_free(ptr);
+        return; // Kept by the thread cache, or not an allocated block
     }
-    if (ret != 0)
+    arena = Arena_get(PageMap_arena_get(ptr));
+    if (Arena_remote_free(arena, ptr) == 0)
     {
-        ZoneAllocatorBig_free(ptr);
+        return; // Freed by its arena on its next allocation
     }
-}
\ No newline at end of file
+    Arena_lock(arena);
+    Arena_block_free(arena, ptr, zone);
+    Arena_unlock(arena);
+}
@@ -1,29 +1,46 @@
 #include "../../ZoneAllocatorTiny/inc_pub/zone_allocator_tiny.h"
 #include "../../ZoneAllocatorSmall/inc_pub/zone_allocator_small.h"
 #include "../../ZoneAllocatorBig/inc_pub/zone_allocator_big.h"
+#include "../../ZoneAllocatorHuge/inc_pub/zone_allocator_huge.h"
+#include "../../Arena/inc_pub/arena.h"
+#include "../../ThreadCache/inc_pub/thread_cache.h"
 #include <stddef.h>
 
 void *ft_malloc(size_t size)
 {
-    
+    arena_t *arena;
     void *ptr = NULL;
-    if (size <= TINY_ALLOC_SIZE)
+
+    if (size >= ZoneAllocatorHuge_threshold_get())
     {
-        ptr = ZoneAllocatorTiny_alloc(size);
+        return (ZoneAllocatorHuge_alloc(size)); // One mapping of its own, no arena involved
+    }
+    if (size <= THREAD_CACHE_SIZE_MAX)
+    {
+        ptr = ThreadCache_alloc(size);
         if (ptr != NULL)
         {
             return (ptr);
-        }   
+        }
+    }
+
+    arena = Arena_thread_get();
+    Arena_lock(arena);
+    Arena_remote_drain(arena);
+    if (size <= TINY_ALLOC_SIZE)
+    {
+        ptr = ZoneAllocatorTiny_alloc(&arena->tiny, size);
     }
     
-    if (size <= SMALL_ALLOC_SIZE_MAX)
+    if ((ptr == NULL) && (size <= SMALL_ALLOC_SIZE_MAX))
     {
-        ptr = ZoneAllocatorSmall_alloc(size);
-        if (ptr != NULL)
-        {
-            return (ptr);
-        }  
+        ptr = ZoneAllocatorSmall_alloc(&arena->small, size);
     }
 
-    return (ZoneAllocatorBig_alloc(size));
-}
\ No newline at end of file
+    if (ptr == NULL)
+    {
+        ptr = ZoneAllocatorBig_alloc(&arena->big, size);
+    }
+    Arena_unlock(arena);
+    return (ptr);
+}
@@ -0,0 +1,59 @@
+#include "../../ThreadCache/inc_pub/thread_cache.h"
+#include "../../Arena/inc_pub/arena.h"
+#include "../../ZoneAllocatorHuge/inc_pub/zone_allocator_huge.h"
+#include "../../MapCache/inc_pub/map_cache.h"
+#include "../../Purger/inc_pub/purger.h"
+#include "../inc_pub/malloc.h"
+#include <stddef.h>
+
+// Sets a tuning parameter of the allocator.
+// Returns 1 on success, 0 if the parameter or the value is invalid.
+int ft_mallopt(int param, int value)
+{
+    int ret = 0;
+
+    switch (param)
+    {
+        case FT_M_TCACHE_COUNT:
+            ret = ((value >= 0) && (ThreadCache_capacity_set((size_t)value) == 0)) ? (1) : (0);
+            break;
+        case FT_M_REMOTE_FREE:
+            ret = ((value == 0) || (value == 1)) ? (1) : (0);
+            if (ret == 1)
+            {
+                Arena_remote_enable_set((short)value);
+            }
+            break;
+        case FT_M_MMAP_THRESHOLD:
+            ret = ((value >= 0) && (ZoneAllocatorHuge_threshold_set((size_t)value) == 0)) ? (1) : (0);
+            break;
+        case FT_M_RETAIN_BUDGET:
+            ret = (value >= 0) ? (1) : (0);
+            if (ret == 1)
+            {
+                MapCache_budget_set((size_t)value);
+            }
+            break;
+        case FT_M_RETAIN_DECAY_MS:
+            ret = (value >= 0) ? (1) : (0);
+            if (ret == 1)
+            {
+                MapCache_decay_set((size_t)value);
+            }
+            break;
+        case FT_M_HUGE_PAGES:
+            ret = ((value == 0) || (value == 1)) ? (1) : (0);
+            if (ret == 1)
+            {
+                MapCache_huge_set((short)value);
+            }
+            break;
+        case FT_M_PURGE_INTERVAL_MS:
+            ret = ((value >= 0) && (Purger_interval_set((size_t)value) == 0)) ? (1) : (0);
+            break;
+        default:
+            ret = 0; // Unknown parameter
+            break;
+    }
+    return (ret);
+}
@@ -0,0 +1,21 @@
+#include "../../Purger/inc_pub/purger.h"
+#include "../../ThreadCache/inc_pub/thread_cache.h"
+#include "../inc_pub/malloc.h"
+#include <stddef.h>
+
+// Gives back to the system the pages of the free blocks left untouched since the previous call,
+// and the empty zone mappings kept past their decay period.
+// Returns the number of bytes given back.
+size_t ft_malloc_purge(void)
+{
+    return (Purger_tick());
+}
+
+// Gives back to the system every empty zone mapping and the pages of every free block, keeping pad bytes of slack.
+// The cache of the calling thread is flushed first so its blocks can be released too.
+// Returns the number of bytes given back.
+size_t ft_malloc_trim(size_t pad)
+{
+    ThreadCache_flush();
+    return (Purger_trim(pad));
+}
@@ -1,47 +1,102 @@
 #include "../../ZoneAllocatorTiny/inc_pub/zone_allocator_tiny.h"
 #include "../../ZoneAllocatorSmall/inc_pub/zone_allocator_small.h"
 #include "../../ZoneAllocatorBig/inc_pub/zone_allocator_big.h"
+#include "../../ZoneAllocatorHuge/inc_pub/zone_allocator_huge.h"
+#include "../../PageMap/inc_pub/page_map.h"
+#include "../../VirtualRegion/inc_pub/virtual_region.h"
+#include "../../Arena/inc_pub/arena.h"
 #include "../inc_pub/malloc.h"
 #include <stddef.h>
+#include <string.h>
 
 void *ft_realloc(void* ptr, size_t size)
 {
-    short ret;
-    short free_done = 0;
-    void * temp_ptr = ptr;
+    void *temp_ptr = ptr;
+    size_t old_size = 0;
+    uint8_t zone;
+    arena_t *arena;
 
-    ret = ZoneAllocatorTiny_realloc(&temp_ptr, size);
-    if (temp_ptr != NULL)
+    if (ptr == NULL)
     {
-        return temp_ptr;
+        return (ft_malloc(size));
+    }
+    if (size == 0)
+    {
+        ft_free(ptr);
+        return (NULL);
     }
 
-    temp_ptr = ptr;
-    free_done = (ret == 0) ? 1 : 0;
-
-    if (free_done == 0)
+    zone = VirtualRegion_zone_get(ptr);
+    if (zone == PAGE_MAP_ZONE_NONE)
     {
-        ret = ZoneAllocatorSmall_realloc(&temp_ptr, size);
-        if (temp_ptr != NULL)
+        // Huge blocks are not in the page map and belong to no arena
+        old_size = ZoneAllocatorHuge_capacity_get(ptr);
+        if (old_size == 0)
         {
-            return temp_ptr;
+            return (NULL); // Not allocated by us
         }
-
-        temp_ptr = ptr;
-        free_done = (ret == 0) ? 1 : 0;
-    }
-    if (free_done == 0)
-    {
-        if (ZoneAllocatorBig_size_get(ptr) != 0)
+        if (size >= ZoneAllocatorHuge_threshold_get())
         {
-            ptr = ZoneAllocatorBig_realloc(ptr, size);
-            if (ptr != NULL)
+            temp_ptr = ZoneAllocatorHuge_realloc(ptr, size);
+            if (temp_ptr != NULL)
             {
-                return ptr;
+                return (temp_ptr); // Resized by the kernel, no copy
             }
-            free_done = 1;
         }
+        arena = NULL;
+    }
+    else
+    {
+        // Try to resize in place inside the owning zone of the owning arena
+        arena = Arena_get(PageMap_arena_get(ptr));
+        Arena_lock(arena);
+    }
+    switch (zone)
+    {
+        case PAGE_MAP_ZONE_TINY:
+            if (ZoneAllocatorTiny_realloc(&temp_ptr, size) == 0)
+            {
+                Arena_unlock(arena);
+                return (temp_ptr);
+            }
+            old_size = ZoneAllocatorTiny_capacity_get(ptr);
+            break;
+        case PAGE_MAP_ZONE_SMALL:
+            if (ZoneAllocatorSmall_realloc(&arena->small, &temp_ptr, size) == 0)
+            {
+                Arena_unlock(arena);
+                return (temp_ptr);
+            }
+            old_size = ZoneAllocatorSmall_size_get(&arena->small, ptr);
+            break;
+        case PAGE_MAP_ZONE_BIG:
+            temp_ptr = ZoneAllocatorBig_realloc(&arena->big, ptr, size);
+            if (temp_ptr != NULL)
+            {
+                Arena_unlock(arena);
+                return (temp_ptr);
+            }
+            old_size = ZoneAllocatorBig_capacity_get(ptr);
+            break;
+        default:
+            break;
+    }
+    if (arena != NULL)
+    {
+        Arena_unlock(arena);
+    }
+    if (old_size == 0)
+    {
+        return (NULL); // Not allocated by us
+    }
+
+    // Move the block to a zone that fits the new size, with every byte up to its capacity:
+    // the caller may have used the block up to ft_malloc_usable_size
+    temp_ptr = ft_malloc(size);
+    if (temp_ptr != NULL)
+    {
+        memcpy(temp_ptr, ptr, (old_size < size) ? (old_size) : (size));
+        ft_free(ptr);
     }
-    ptr = ft_malloc(size);
-    return ptr;
-}
\ No newline at end of file
+    return (temp_ptr);
+}
@@ -0,0 +1,25 @@
+#include "../../Arena/inc_pub/arena.h"
+#include "../../ThreadCache/inc_pub/thread_cache.h"
+#include "../../ZoneAllocatorHuge/inc_pub/zone_allocator_huge.h"
+#include "../inc_pub/malloc.h"
+#include <stddef.h>
+
+// Prints the blocks allocated in every zone of every arena.
+// The cache of the calling thread is flushed first so its blocks do not show up as allocated.
+void ft_malloc_report(void)
+{
+    arena_t *arena;
+
+    ThreadCache_flush();
+    for (size_t i = 0u; i < Arena_count_get(); i++)
+    {
+        arena = Arena_get((uint8_t)i);
+        Arena_lock(arena);
+        Arena_remote_drain(arena);
+        ZoneAllocatorTiny_report(&arena->tiny);
+        ZoneAllocatorSmall_report(&arena->small);
+        ZoneAllocatorBig_report(&arena->big);
+        Arena_unlock(arena);
+    }
+    ZoneAllocatorHuge_report();
+}
@@ -0,0 +1,15 @@
+#include "../../ThreadCache/inc_pub/thread_cache.h"
+#include "../../MapCache/inc_pub/map_cache.h"
+#include "../inc_pub/malloc.h"
+#include <stddef.h>
+
+// Fills stats with the counters of the allocator.
+void ft_malloc_stats_get(ft_malloc_stats_t *stats)
+{
+    if (stats == NULL)
+    {
+        return;
+    }
+    ThreadCache_stats_get(&stats->tcache_hits, &stats->tcache_misses, &stats->tcache_flushes);
+    stats->retained_bytes = MapCache_retained_get();
+}
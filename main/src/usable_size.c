@@ -0,0 +1,40 @@
+#include "../../ZoneAllocatorTiny/inc_pub/zone_allocator_tiny.h"
+#include "../../ZoneAllocatorSmall/inc_pub/zone_allocator_small.h"
+#include "../../ZoneAllocatorBig/inc_pub/zone_allocator_big.h"
+#include "../../ZoneAllocatorHuge/inc_pub/zone_allocator_huge.h"
+#include "../../PageMap/inc_pub/page_map.h"
+#include "../../VirtualRegion/inc_pub/virtual_region.h"
+#include "../../Arena/inc_pub/arena.h"
+#include "../inc_pub/malloc.h"
+#include <stddef.h>
+
+// Returns the number of bytes the block ptr can hold: the slot size of a tiny block,
+// the payload of a small or big block, the mapped size of a huge block. 0 if ptr is NULL or not ours.
+// Every byte up to it may be used, ft_realloc keeps them all when it moves the block.
+// Nothing is walked: the zone comes from the address, the capacity from the slab or the block header.
+// A big header is read under the arena lock, the frees of its neighbors set a flag in the same word.
+size_t ft_malloc_usable_size(void *ptr)
+{
+    arena_t *arena;
+    size_t capacity;
+
+    if (ptr == NULL)
+    {
+        return (0);
+    }
+    switch (VirtualRegion_zone_get(ptr))
+    {
+        case PAGE_MAP_ZONE_TINY:
+            return (ZoneAllocatorTiny_capacity_get(ptr));
+        case PAGE_MAP_ZONE_SMALL:
+            return (ZoneAllocatorSmall_capacity_get(ptr));
+        case PAGE_MAP_ZONE_BIG:
+            arena = Arena_get(PageMap_arena_get(ptr));
+            Arena_lock(arena);
+            capacity = ZoneAllocatorBig_capacity_get(ptr);
+            Arena_unlock(arena);
+            return (capacity);
+        default:
+            return (ZoneAllocatorHuge_capacity_get(ptr));
+    }
+}
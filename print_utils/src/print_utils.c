@@ -91,7 +91,7 @@ char *itoa_size(size_t num, int base, int size, char *buffer)
 // It converts the address to a string and prints it.
 void print_address_as_hex(void *ptr)
 {
-    char num_str[16]; // Buffer to hold the hex string
+    char num_str[17]; // Buffer to hold the hex string and its terminator
     unsigned long address = (unsigned long)ptr;
     itoa_size(address, 16, 16, num_str); // Convert address to hex string
     write (1, "0x", 2); // Print the prefix
@@ -0,0 +1,70 @@
+#include "../main/inc_pub/malloc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Throughput of ft_malloc_batch and ft_free_batch against one ft_malloc and ft_free per object.
+// Each round allocates BENCH_OBJECTS objects of one size, then frees them, the per object loops
+// go through the thread cache, the batch calls go to the zones in one pass.
+// Build: make bench, then run build/testing/bench_batch
+
+#define BENCH_OBJECTS 4096 // Objects allocated and freed by one round
+#define BENCH_ROUNDS 500 // Rounds measured for each size
+
+// Helper to measure time in nanoseconds
+long long get_time_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Time of one ft_malloc and ft_free per object, in nanoseconds per object
+double benchmark_single(void** ptrs, size_t size) {
+    long long start = get_time_ns();
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        for (int i = 0; i < BENCH_OBJECTS; i++) {
+            ptrs[i] = ft_malloc(size);
+            *(char*)ptrs[i] = (char)i;
+        }
+        for (int i = 0; i < BENCH_OBJECTS; i++) {
+            ft_free(ptrs[i]);
+        }
+    }
+    return (double)(get_time_ns() - start) / ((double)BENCH_ROUNDS * BENCH_OBJECTS);
+}
+
+// Time of the batch calls, in nanoseconds per object
+double benchmark_batch(void** ptrs, size_t size) {
+    long long start = get_time_ns();
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        if (ft_malloc_batch(size, BENCH_OBJECTS, ptrs) != BENCH_OBJECTS) {
+            printf("Batch allocation failed\n");
+            exit(1);
+        }
+        for (int i = 0; i < BENCH_OBJECTS; i++) {
+            *(char*)ptrs[i] = (char)i;
+        }
+        ft_free_batch(ptrs, BENCH_OBJECTS);
+    }
+    return (double)(get_time_ns() - start) / ((double)BENCH_ROUNDS * BENCH_OBJECTS);
+}
+
+int main() {
+    const size_t sizes[] = {16, 64, 1024};
+    void** ptrs = malloc(BENCH_OBJECTS * sizeof(void*));
+
+    if (!ptrs) {
+        printf("Setup failed\n");
+        return 1;
+    }
+    printf("\n=== %d objects allocated then freed, ns per object ===\n", BENCH_OBJECTS);
+    printf("%-6s : %10s %10s %8s\n", "Size", "single", "batch", "speedup");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        benchmark_batch(ptrs, sizes[s]); // Warm up the zones
+        double single = benchmark_single(ptrs, sizes[s]);
+        double batch = benchmark_batch(ptrs, sizes[s]);
+        printf("%-6zu : %10.1f %10.1f %7.2fx\n", sizes[s], single, batch, single / batch);
+    }
+    free(ptrs);
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include "../main/inc_pub/malloc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+// Random reads and writes over a 1 GB heap of 32 KB blocks, with the huge page mode off and on.
+// Every access lands on a random page of a random block, so the run is bound by dTLB misses.
+// Each mode runs in a child process, the mode applies to the zones mapped after it is set.
+// Build: make bench, then run build/testing/bench_huge_pages
+
+#define BENCH_BLOCK_SIZE (32 * 1024) // Size of one block, served by the big zone
+#define BENCH_HEAP_SIZE (1024L * 1024L * 1024L) // Bytes allocated in total
+#define BENCH_BLOCKS (BENCH_HEAP_SIZE / BENCH_BLOCK_SIZE)
+#define BENCH_ACCESSES 20000000L // Random accesses measured
+
+// Helper to measure time in nanoseconds
+long long get_time_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Returns the kilobytes of the process backed by transparent huge pages
+long anon_huge_kb() {
+    FILE* file = fopen("/proc/self/smaps_rollup", "r");
+    char line[256];
+    long kb = -1;
+
+    if (!file) return -1;
+    while (fgets(line, sizeof(line), file)) {
+        if (sscanf(line, "AnonHugePages: %ld kB", &kb) == 1) break;
+    }
+    fclose(file);
+    return kb;
+}
+
+// Fills the heap, then times the random accesses, returns the exit status of the child
+int benchmark_random_access(int huge) {
+    char** blocks = malloc(BENCH_BLOCKS * sizeof(char*));
+    unsigned long long state = 88172645463325252ULL;
+    unsigned long long sum = 0;
+
+    if (!blocks || !ft_mallopt(FT_M_HUGE_PAGES, huge)) {
+        printf("Setup failed\n");
+        return 1;
+    }
+    long long start = get_time_ns();
+    for (long i = 0; i < BENCH_BLOCKS; i++) {
+        blocks[i] = ft_malloc(BENCH_BLOCK_SIZE);
+        if (!blocks[i]) {
+            printf("Allocation %ld failed\n", i);
+            return 1;
+        }
+        memset(blocks[i], (int)i, BENCH_BLOCK_SIZE);
+    }
+    long long filled = get_time_ns();
+    for (long i = 0; i < BENCH_ACCESSES; i++) {
+        state ^= state << 13; // xorshift64
+        state ^= state >> 7;
+        state ^= state << 17;
+        char* block = blocks[(state >> 16) % BENCH_BLOCKS];
+        size_t offset = (size_t)(state & (BENCH_BLOCK_SIZE - 1)) & ~(size_t)7;
+        sum += (unsigned char)block[offset];
+        block[offset] = (char)sum;
+    }
+    long long end = get_time_ns();
+    printf("fill %7.1f ms, %5.1f ns per random access, %5ld MB in huge pages (%llu)",
+           (filled - start) / 1e6, (double)(end - filled) / BENCH_ACCESSES, anon_huge_kb() / 1024, sum & 1);
+    fflush(stdout);
+    for (long i = 0; i < BENCH_BLOCKS; i++) {
+        ft_free(blocks[i]);
+    }
+    free(blocks);
+    return 0;
+}
+
+// Runs one mode in a child process
+void run(const char* name, int huge) {
+    int status;
+
+    printf("%-12s : ", name);
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        exit(benchmark_random_access(huge));
+    }
+    if (pid < 0 || waitpid(pid, &status, 0) < 0) {
+        printf("Failed to run the child\n");
+        return;
+    }
+    printf("\n");
+}
+
+int main() {
+    printf("\n=== Random access over a 1 GB heap of 32 KB blocks ===\n");
+    run("Huge pages 0", 0);
+    run("Huge pages 1", 1);
+    return 0;
+}
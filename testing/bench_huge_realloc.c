@@ -0,0 +1,76 @@
+#include "../main/inc_pub/malloc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+// Grows one buffer from 1 MB to 1 GB through realloc, 1 MB at a time, touching every new page.
+// Each run happens in a child process so its peak resident size can be read on its own.
+// Build: make bench, then run build/testing/bench_huge_realloc
+
+#define BENCH_STEP (1024 * 1024) // Growth of each realloc
+#define BENCH_SIZE_MAX (1024 * 1024 * 1024) // Final size of the buffer
+#define PAGE_SIZE 4096
+
+typedef void* (*realloc_fn)(void*, size_t);
+typedef void (*free_fn)(void*);
+
+// Helper to measure time in nanoseconds
+long long get_time_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Grows the buffer and prints the time spent, returns the exit status of the child
+int benchmark_growth(realloc_fn re_alloc, free_fn dealloc) {
+    char* buffer = NULL;
+    size_t moves = 0;
+
+    long long start = get_time_ns();
+    for (size_t size = BENCH_STEP; size <= BENCH_SIZE_MAX; size += BENCH_STEP) {
+        char* grown = re_alloc(buffer, size);
+        if (!grown) {
+            printf("Realloc to %zu bytes failed\n", size);
+            return 1;
+        }
+        moves += (grown != buffer);
+        buffer = grown;
+        for (size_t i = size - BENCH_STEP; i < size; i += PAGE_SIZE) {
+            buffer[i] = (char)i; // Touch the new pages
+        }
+    }
+    long long elapsed = get_time_ns() - start;
+    dealloc(buffer);
+    printf("%8.2f ms total, %6.2f us per realloc, %zu moves", elapsed / 1e6,
+           elapsed / 1e3 / (BENCH_SIZE_MAX / BENCH_STEP), moves);
+    fflush(stdout);
+    return 0;
+}
+
+// Runs one allocator in a child process and prints its peak resident size
+void run(const char* name, realloc_fn re_alloc, free_fn dealloc) {
+    struct rusage usage;
+    int status;
+
+    printf("%-8s : ", name);
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        exit(benchmark_growth(re_alloc, dealloc));
+    }
+    if (pid < 0 || wait4(pid, &status, 0, &usage) < 0) {
+        printf("Failed to run the child\n");
+        return;
+    }
+    printf(", peak RSS %ld MB\n", usage.ru_maxrss / 1024);
+}
+
+int main() {
+    printf("\n=== Realloc growth from 1 MB to 1 GB in 1 MB steps ===\n");
+    run("Custom", ft_realloc, ft_free);
+    run("Standard", realloc, free);
+    return 0;
+}
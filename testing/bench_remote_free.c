@@ -0,0 +1,87 @@
+#include "../main/inc_pub/malloc.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Producer/consumer ping-pong: one thread allocates messages, a second thread frees them.
+// The two threads are given consecutive arenas, so every free is a remote free.
+// The run is repeated with the remote lists disabled (the consumer locks the producer arena)
+// and enabled (the consumer pushes the blocks with one compare and swap), with and without the thread cache.
+// The arenas are one per online cpu: on a single cpu machine both threads share one arena and no free is remote.
+// Build: make bench, then run build/testing/bench_remote_free
+
+#define BENCH_MESSAGES 4000000 // Messages sent for each configuration
+#define BENCH_RING_SIZE 1024 // Slots of the ring between the two threads, power of two
+#define BENCH_MESSAGE_SIZE 48 // Size of one message
+
+typedef struct {
+    void* slots[BENCH_RING_SIZE];
+    size_t head; // Next slot written by the producer
+    size_t tail; // Next slot read by the consumer
+} ring_t;
+
+ring_t ring;
+
+// Helper to measure time in nanoseconds
+long long get_time_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void* producer(void* arg) {
+    (void)arg;
+    for (size_t i = 0; i < BENCH_MESSAGES; i++) {
+        void* message = ft_malloc(BENCH_MESSAGE_SIZE);
+        *(size_t*)message = i;
+        while (i - __atomic_load_n(&ring.tail, __ATOMIC_ACQUIRE) >= BENCH_RING_SIZE) {
+            sched_yield(); // Ring full, let the consumer catch up
+        }
+        ring.slots[i & (BENCH_RING_SIZE - 1)] = message;
+        __atomic_store_n(&ring.head, i + 1, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+void* consumer(void* arg) {
+    (void)arg;
+    for (size_t i = 0; i < BENCH_MESSAGES; i++) {
+        while (__atomic_load_n(&ring.head, __ATOMIC_ACQUIRE) == i) {
+            sched_yield(); // Ring empty, let the producer run
+        }
+        ft_free(ring.slots[i & (BENCH_RING_SIZE - 1)]);
+        __atomic_store_n(&ring.tail, i + 1, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+// Frees per second of one producer/consumer run
+void benchmark_ping_pong(int remote_free, int tcache_count) {
+    pthread_t threads[2];
+
+    ft_mallopt(FT_M_REMOTE_FREE, remote_free);
+    ft_mallopt(FT_M_TCACHE_COUNT, tcache_count);
+    ring.head = 0;
+    ring.tail = 0;
+
+    long long start = get_time_ns();
+    pthread_create(&threads[0], NULL, producer, NULL);
+    pthread_create(&threads[1], NULL, consumer, NULL);
+    pthread_join(threads[0], NULL);
+    pthread_join(threads[1], NULL);
+    long long elapsed = get_time_ns() - start;
+
+    printf("remote queue %-3s, tcache %4d : %8.2f M frees/s\n", remote_free ? "on" : "off", tcache_count,
+           (double)BENCH_MESSAGES * 1000.0 / (double)elapsed);
+}
+
+int main() {
+    printf("\n=== Cross-thread free ping-pong (%d messages of %d bytes) ===\n", BENCH_MESSAGES, BENCH_MESSAGE_SIZE);
+    benchmark_ping_pong(0, 0);
+    benchmark_ping_pong(1, 0);
+    benchmark_ping_pong(0, 32);
+    benchmark_ping_pong(1, 32);
+    return 0;
+}
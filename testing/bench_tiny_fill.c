@@ -0,0 +1,79 @@
+#include "../main/inc_pub/malloc.h"
+#include "../ZoneAllocatorTiny/inc_pub/zone_allocator_tiny.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Measures the latency of a tiny allocation against the fill level of the tiny slabs.
+// For each level the slabs are filled, a random share of the slots is freed so that
+// every slab is left at about that fill level, then the freed slots are allocated again.
+// Build: make bench, then run build/testing/bench_tiny_fill
+
+#define BENCH_OBJECTS 65536 // Number of tiny objects used for each fill level
+#define BENCH_ROUNDS 20 // Number of refills measured for each fill level
+
+// Helper to measure time in nanoseconds
+long long get_time_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Fisher-Yates shuffle of the indexes to free
+void shuffle(int* order, int count) {
+    for (int i = count - 1; i > 0; i--) {
+        int j = rand() % (i + 1);
+        int temp = order[i];
+        order[i] = order[j];
+        order[j] = temp;
+    }
+}
+
+// Allocation latency at one fill level, in percent of used slots
+void benchmark_fill_level(void** ptrs, int* order, int fill) {
+    const int holes = BENCH_OBJECTS - (BENCH_OBJECTS * fill) / 100;
+    long long total = 0;
+
+    for (int i = 0; i < BENCH_OBJECTS; i++) {
+        ptrs[i] = ft_malloc(TINY_ALLOC_SIZE);
+    }
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        shuffle(order, BENCH_OBJECTS);
+        for (int i = 0; i < holes; i++) {
+            ft_free(ptrs[order[i]]);
+        }
+        long long start = get_time_ns();
+        for (int i = 0; i < holes; i++) {
+            ptrs[order[i]] = ft_malloc(TINY_ALLOC_SIZE);
+        }
+        total += get_time_ns() - start;
+    }
+    for (int i = 0; i < BENCH_OBJECTS; i++) {
+        ft_free(ptrs[i]);
+    }
+    printf("fill %3d%% : %8.2f ns per alloc\n", fill, (holes == 0) ? 0.0 : (double)total / ((double)holes * BENCH_ROUNDS));
+}
+
+int main() {
+    const int levels[] = {0, 25, 50, 75, 90, 95, 99};
+    void** ptrs = malloc(BENCH_OBJECTS * sizeof(void*));
+    int* order = malloc(BENCH_OBJECTS * sizeof(int));
+
+    if (!ptrs || !order) {
+        printf("Failed to alloc bench arrays\n");
+        return 1;
+    }
+    srand(time(NULL));
+    for (int i = 0; i < BENCH_OBJECTS; i++) {
+        order[i] = i;
+    }
+
+    printf("\n=== Tiny alloc latency against fill level (%d objects) ===\n", BENCH_OBJECTS);
+    for (size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); i++) {
+        benchmark_fill_level(ptrs, order, levels[i]);
+    }
+
+    free(ptrs);
+    free(order);
+    return 0;
+}
@@ -2,6 +2,11 @@
 #include "../ZoneAllocatorTiny/inc_pub/zone_allocator_tiny.h"
 #include "../ZoneAllocatorSmall/inc_pub/zone_allocator_small.h"
 #include "../ZoneAllocatorBig/inc_pub/zone_allocator_big.h"
+#include "../PageMap/inc_pub/page_map.h"
+#include "../Arena/inc_pub/arena.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -44,8 +49,358 @@ typedef void* (*alloc_func)(size_t);
 typedef void (*free_func)(void*);
 typedef void* (*realloc_func)(void*, size_t);
 
+int failures = 0; // Checks that failed, main returns 1 if there is any
+
+// Prints the result of one check and counts the failures
+void check(const char* what, int ok) {
+    printf("%s: %s\n", what, ok ? "OK" : "FAILED");
+    if (!ok) failures++;
+}
+
+// Returns 1 if the size bytes at ptr are all 0
+int all_zero(const void* ptr, size_t size) {
+    const unsigned char* bytes = ptr;
+    for (size_t i = 0; i < size; i++) {
+        if (bytes[i] != 0) return 0;
+    }
+    return 1;
+}
+
+// Allocates count blocks with ft_calloc and returns 1 if all of them read as zero.
+// The blocks are then filled with garbage and freed, so the next round gets dirty memory back.
+int calloc_round(size_t size, int count, void** ptrs) {
+    int ok = 1;
+    for (int i = 0; i < count; i++) {
+        ptrs[i] = ft_calloc(1, size);
+        ok = ok && ptrs[i] && all_zero(ptrs[i], size);
+    }
+    for (int i = 0; i < count; i++) {
+        if (ptrs[i]) memset(ptrs[i], 0xA5, size);
+    }
+    for (int i = 0; i < count; i++) {
+        ft_free(ptrs[i]);
+    }
+    return ok;
+}
+
+// ft_calloc only clears the memory that may hold old data, every path that skips the memset is checked here:
+// fresh zone maps, dirty blocks and slots freed just before, maps kept by the map cache and reused,
+// purged blocks and the tails split off purged blocks.
+void test_calloc_zeroing(void) {
+    const size_t sizes[] = {1, 40, TINY_ALLOC_SIZE, 200, 1000, 3000, SMALL_ALLOC_SIZE_MAX, 5000, 20000, 60000, 100000, 300000, 4 << 20};
+    static void* ptrs[400];
+    void* pins[25];
+    char what[128];
+
+    printf("\n=== ft_calloc zeroing ===\n");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        int count = (sizes[s] <= 100000) ? 400 : 8; // Enough blocks to map several zones of the tier
+        int ok = 1;
+        for (int round = 0; round < 3; round++) {
+            ok = ok && calloc_round(sizes[s], count, ptrs); // Round 0 maps new zones, the next ones reuse dirty memory
+        }
+        snprintf(what, sizeof(what), "calloc %zu bytes, fresh then dirty", sizes[s]);
+        check(what, ok);
+    }
+
+    // Dirty tiny slots and small blocks with the thread cache off, they come back from the zones themselves
+    ft_mallopt(FT_M_TCACHE_COUNT, 0);
+    check("calloc tiny and small without thread cache", calloc_round(48, 400, ptrs) && calloc_round(48, 400, ptrs)
+          && calloc_round(2000, 400, ptrs) && calloc_round(2000, 400, ptrs));
+    ft_mallopt(FT_M_TCACHE_COUNT, 32);
+
+    // Purged blocks: dirty blocks are freed and merged, two purge ticks give their pages back,
+    // then smaller requests take the head of the purged block and the tails split off it
+    const size_t purged_sizes[] = {3000, 9000, 20000};
+    for (size_t s = 0; s < sizeof(purged_sizes) / sizeof(purged_sizes[0]); s++) {
+        size_t size = purged_sizes[s];
+        int ok = 1;
+        for (int i = 0; i < 100; i++) {
+            ptrs[i] = ft_malloc(size);
+            if (ptrs[i]) memset(ptrs[i], 0x5A, size);
+        }
+        for (int i = 0; i < 100; i++) {
+            if (i % 4 != 3) ft_free(ptrs[i]);
+            else pins[i / 4] = ptrs[i]; // Keeps every map in use, an empty map would be released instead of purged
+        }
+        ft_malloc_purge();
+        ft_malloc_purge();
+        for (int i = 0; i < 300; i++) {
+            size_t part = size / 3 + (size_t)(i % 7) * 16;
+            ptrs[i] = ft_calloc(1, part);
+            ok = ok && ptrs[i] && all_zero(ptrs[i], part);
+        }
+        for (int i = 0; i < 300; i++) {
+            ft_free(ptrs[i]);
+        }
+        for (int i = 0; i < 25; i++) {
+            ft_free(pins[i]);
+        }
+        snprintf(what, sizeof(what), "calloc from purged %zu byte blocks and their split tails", size);
+        check(what, ok);
+    }
+
+    // Overflow of count * size
+    check("calloc overflow returns NULL", ft_calloc((size_t)-1 / 8, 16) == NULL);
+}
+
+// Returns 1 if ptr is aligned, usable for size bytes, keeps its bytes through ft_realloc and is freed.
+// Several blocks are kept at once so that the big zone splits the slack in front of an aligned block for the next one.
+int aligned_round(size_t alignment, size_t size) {
+    void* ptrs[8];
+    int ok = 1;
+    for (int i = 0; i < 8; i++) {
+        ptrs[i] = ft_aligned_alloc(alignment, size);
+        ok = ok && ptrs[i] && ((uintptr_t)ptrs[i] % alignment == 0) && (ft_malloc_usable_size(ptrs[i]) >= size);
+        if (ptrs[i]) memset(ptrs[i], i + 1, size);
+    }
+    for (int i = 0; i < 8; i += 2) {
+        ft_free(ptrs[i]); // Leaves holes next to the aligned blocks still in use
+    }
+    for (int i = 1; ok && i < 8; i += 2) {
+        unsigned char* grown = ft_realloc(ptrs[i], size * 2 + 1);
+        ok = ok && grown && (ft_malloc_usable_size(grown) >= size * 2 + 1);
+        for (size_t j = 0; ok && j < size; j++) {
+            ok = (grown[j] == (unsigned char)(i + 1));
+        }
+        ptrs[i] = grown ? (void*)grown : ptrs[i];
+    }
+    for (int i = 1; i < 8; i += 2) {
+        ft_free(ptrs[i]);
+    }
+    return ok;
+}
+
+// ft_aligned_alloc and ft_posix_memalign on every tier: tiny slots of a naturally aligned class,
+// big blocks aligned by splitting off the slack in front, and huge mappings, for alignments from 16 bytes
+// up to and past the page size.
+void test_aligned_alloc(void) {
+    const size_t sizes[] = {1, 24, TINY_ALLOC_SIZE, 100, 1000, 3000, 20000, 100000, 300000};
+    const size_t page_size = (size_t)getpagesize();
+    char what[128];
+    void* ptr = NULL;
+
+    printf("\n=== ft_aligned_alloc ===\n");
+    for (size_t alignment = 16; alignment <= page_size * 4; alignment *= 2) {
+        int ok = 1;
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            ok = ok && aligned_round(alignment, sizes[s]);
+        }
+        snprintf(what, sizeof(what), "aligned alloc, realloc, usable size and free at alignment %zu", alignment);
+        check(what, ok);
+    }
+
+    check("posix_memalign size 0 succeeds", ft_posix_memalign(&ptr, 64, 0) == 0 && ptr && (uintptr_t)ptr % 64 == 0);
+    ft_free(ptr);
+    ptr = ft_aligned_alloc(64, 0);
+    check("aligned_alloc size 0 returns a block", ptr != NULL);
+    ft_free(ptr);
+    ptr = NULL;
+    check("posix_memalign rejects alignment 24", ft_posix_memalign(&ptr, 24, 100) == EINVAL && ptr == NULL);
+    check("aligned_alloc rejects alignment 48", ft_aligned_alloc(48, 100) == NULL);
+}
+
+// Counts the blocks listed by ft_malloc_report and the bytes they use, the report goes to a temporary file.
+void report_usage(size_t* blocks, size_t* bytes) {
+    FILE* file = tmpfile();
+    char line[256];
+    size_t size;
+    int saved = dup(1);
+
+    *blocks = 0;
+    *bytes = 0;
+    if (!file || saved < 0) return;
+    fflush(stdout);
+    dup2(fileno(file), 1);
+    ft_malloc_report();
+    dup2(saved, 1);
+    close(saved);
+    rewind(file);
+    while (fgets(line, sizeof(line), file)) {
+        if (sscanf(line, "%*s - %*s : %zu", &size) == 1) {
+            (*blocks)++;
+            *bytes += size;
+        }
+    }
+    fclose(file);
+}
+
+// Fills every block with its index, returns 1 if no block overwrote another one and every block is usable for size bytes
+int blocks_distinct(void** ptrs, size_t count, size_t size) {
+    int ok = 1;
+    for (size_t i = 0; i < count; i++) {
+        ok = ok && ptrs[i] && ft_malloc_usable_size(ptrs[i]) >= size;
+        if (ptrs[i]) memset(ptrs[i], (int)(i % 251), size);
+    }
+    for (size_t i = 0; ok && i < count; i++) {
+        ok = ((unsigned char*)ptrs[i])[0] == i % 251 && ((unsigned char*)ptrs[i])[size - 1] == i % 251;
+    }
+    return ok;
+}
+
+// Fisher-Yates shuffle of the pointers
+void ptrs_shuffle(void** ptrs, size_t count) {
+    for (size_t i = count - 1; i > 0; i--) {
+        size_t j = (size_t)rand() % (i + 1);
+        void* temp = ptrs[i];
+        ptrs[i] = ptrs[j];
+        ptrs[j] = temp;
+    }
+}
+
+#define BATCH_TEST_COUNT 1000 // Blocks of one batch below the big sizes
+
+// Allocates a batch in a thread of its own, so its blocks belong to another arena than the ones of the main thread
+void* batch_thread(void* arg) {
+    void** ptrs = arg;
+    size_t got = ft_malloc_batch(48, BATCH_TEST_COUNT, ptrs);
+    got += ft_malloc_batch(2000, BATCH_TEST_COUNT, ptrs + BATCH_TEST_COUNT);
+    return (void*)(uintptr_t)got;
+}
+
+// ft_malloc_batch and ft_free_batch round trips on every tier, in allocation order, shuffled, with NULL entries
+// and with blocks of two arenas mixed. Every round has to leave the zones as it found them.
+void test_batch(void) {
+    const size_t sizes[] = {16, 64, 1000, SMALL_ALLOC_SIZE_MAX, 20000, 300000};
+    static void* ptrs[BATCH_TEST_COUNT * 4];
+    size_t blocks_before, bytes_before, blocks_after, bytes_after;
+    char what[128];
+    pthread_t thread;
+
+    printf("\n=== ft_malloc_batch and ft_free_batch ===\n");
+    srand(42);
+    report_usage(&blocks_before, &bytes_before);
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t count = (sizes[s] <= SMALL_ALLOC_SIZE_MAX) ? BATCH_TEST_COUNT : 50;
+        int ok = 1;
+        for (int mode = 0; mode < 3; mode++) {
+            size_t got = ft_malloc_batch(sizes[s], count, ptrs);
+            size_t total = got;
+            ok = ok && got == count && blocks_distinct(ptrs, got, sizes[s]);
+            if (mode >= 1) ptrs_shuffle(ptrs, got);
+            if (mode == 2) {
+                for (size_t i = 0; i < got; i += 3) {
+                    ptrs[total++] = ptrs[i]; // Moved to the end, a NULL takes its place
+                    ptrs[i] = NULL;
+                }
+            }
+            ft_free_batch(ptrs, total);
+            report_usage(&blocks_after, &bytes_after);
+            ok = ok && blocks_after == blocks_before && bytes_after == bytes_before;
+        }
+        snprintf(what, sizeof(what), "batch of %zu blocks of %zu bytes, in order, shuffled and with NULL entries", count, sizes[s]);
+        check(what, ok);
+    }
+
+    // Blocks of another arena, interleaved with blocks of the main thread and freed by it.
+    // Arenas are handed to new threads in turn, so one of the next Arena_count_get threads gets another arena.
+    int ok = ft_malloc_batch(48, BATCH_TEST_COUNT, ptrs + BATCH_TEST_COUNT * 2) == BATCH_TEST_COUNT;
+    ok = ok && ft_malloc_batch(2000, BATCH_TEST_COUNT, ptrs + BATCH_TEST_COUNT * 3) == BATCH_TEST_COUNT;
+    int other = 0;
+    for (size_t tries = 0; ok && !other && tries < Arena_count_get(); tries++) {
+        void* got = NULL;
+        ok = pthread_create(&thread, NULL, batch_thread, ptrs) == 0;
+        ok = ok && pthread_join(thread, &got) == 0 && (uintptr_t)got == BATCH_TEST_COUNT * 2;
+        other = ok && PageMap_arena_get(ptrs[0]) != PageMap_arena_get(ptrs[BATCH_TEST_COUNT * 2]);
+        if (ok && !other && tries + 1 < Arena_count_get()) ft_free_batch(ptrs, BATCH_TEST_COUNT * 2); // Same arena as the main thread, try the next thread
+    }
+    ok = ok && blocks_distinct(ptrs, BATCH_TEST_COUNT * 4, 48);
+    for (size_t i = 0; i < BATCH_TEST_COUNT * 2; i += 2) {
+        void* temp = ptrs[i]; // Every other block of the thread swapped with a block of the main thread
+        ptrs[i] = ptrs[i + BATCH_TEST_COUNT * 2];
+        ptrs[i + BATCH_TEST_COUNT * 2] = temp;
+    }
+    ft_free_batch(ptrs, BATCH_TEST_COUNT * 4);
+    report_usage(&blocks_after, &bytes_after);
+    check(other ? "batch mixing the blocks of two arenas" : "batch mixing the blocks of two threads (one arena only)",
+          ok && blocks_after == blocks_before && bytes_after == bytes_before);
+}
+
+// ft_arena_* blocks are aligned and apart, a request larger than a chunk gets a chunk of its own, a reset rewinds
+// the first chunk and keeps or frees the others, and the destroy gives the big zone back its usage before the create.
+void test_bump_arena(void) {
+    const size_t chunk = 4096;
+    size_t blocks_before, bytes_before, blocks_after, bytes_after;
+    void* ptrs[200];
+
+    printf("\n=== ft_arena ===\n");
+    for (int keep = 0; keep <= 1; keep++) {
+        report_usage(&blocks_before, &bytes_before);
+        ft_arena_t* arena = ft_arena_create(chunk, keep);
+        int ok = arena != NULL;
+        for (size_t i = 0; ok && i < 200; i++) {
+            ptrs[i] = ft_arena_alloc(arena, 1 + (i * 37) % 300); // Spills over a few chunks
+            ok = ptrs[i] && (uintptr_t)ptrs[i] % FT_MALLOC_ALIGNMENT == 0;
+        }
+        for (size_t i = 0; ok && i < 200; i++) {
+            memset(ptrs[i], (int)(i % 251), 1 + (i * 37) % 300);
+        }
+        for (size_t i = 0; ok && i < 200; i++) {
+            ok = ((unsigned char*)ptrs[i])[(i * 37) % 300] == i % 251;
+        }
+        check(keep ? "arena blocks aligned and apart (keep_chunks 1)" : "arena blocks aligned and apart (keep_chunks 0)", ok);
+
+        void* before = ft_arena_alloc(arena, 16);
+        void* large = ft_arena_alloc(arena, chunk * 3);
+        void* after = ft_arena_alloc(arena, 16);
+        ok = before && large && after && (uintptr_t)large % FT_MALLOC_ALIGNMENT == 0;
+        if (ok) {
+            memset(before, 0x11, 16);
+            memset(after, 0x22, 16);
+            memset(large, 0x33, chunk * 3);
+        }
+        ok = ok && (uint8_t*)after == (uint8_t*)before + 16 && ((uint8_t*)before)[15] == 0x11 && ((uint8_t*)after)[15] == 0x22;
+        check("arena request larger than a chunk in a chunk of its own, bumping goes on in the current one", ok);
+
+        ft_arena_reset(arena);
+        void* first = ft_arena_alloc(arena, 32);
+        check("arena reset rewinds the first chunk", first == ptrs[0]);
+        void* large_again = ft_arena_alloc(arena, chunk * 3);
+        report_usage(&blocks_after, &bytes_after);
+        if (keep) {
+            check("arena reset keeps the chunks with keep_chunks 1", large_again == large && blocks_after > blocks_before + 2);
+        } else {
+            check("arena reset frees the other chunks with keep_chunks 0", large_again && blocks_after == blocks_before + 2);
+        }
+
+        ft_arena_reset(arena); // The last large chunk went behind the first one, a reset has to find it there
+        ft_arena_destroy(arena);
+        report_usage(&blocks_after, &bytes_after);
+        check("arena destroy gives the big zone back its usage before the create", blocks_after == blocks_before && bytes_after == bytes_before);
+    }
+}
+
+// A double free or the free of an address inside a block is ignored on every path, through the thread cache
+// or straight to the zones, so the block is not handed out twice.
+void test_invalid_free(void) {
+    const size_t sizes[] = {24, 200, 1000, 3000};
+    char what[128];
+
+    printf("\n=== Double and invalid frees ===\n");
+    for (int cached = 1; cached >= 0; cached--) {
+        ft_mallopt(FT_M_TCACHE_COUNT, cached ? 32 : 0);
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            char* p = ft_malloc(sizes[s]);
+            ft_free(p);
+            ft_free(p);
+            ft_free_sized(p, sizes[s]);
+            char* a = ft_malloc(sizes[s]);
+            char* b = ft_malloc(sizes[s]);
+            ft_free(a + 16);
+            char* c = ft_malloc(sizes[s]);
+            snprintf(what, sizeof(what), "double and inner frees of %zu bytes ignored (thread cache %s)", sizes[s], cached ? "on" : "off");
+            check(what, a && b && c && a != b && c != a && c != b && ft_malloc_usable_size(a) >= sizes[s]);
+            ft_free(a);
+            ft_free(b);
+            ft_free(c);
+        }
+    }
+    ft_mallopt(FT_M_TCACHE_COUNT, 32);
+}
+
 // Functionality tests (with leak-prone scenarios for Valgrind)
 void test_functionality(const char* name, alloc_func alloc, free_func dealloc, realloc_func re_alloc) {
+    (void)re_alloc; // Same signature for every test, this one does not realloc
     printf("\n=== Functionality Tests for %s ===\n", name);
 
     // Test 1: Allocate 0 bytes
@@ -124,6 +479,7 @@ void test_functionality(const char* name, alloc_func alloc, free_func dealloc, r
 
 // Speed benchmark
 void benchmark_speed(const char* name, alloc_func alloc, free_func dealloc, realloc_func re_alloc) {
+    (void)re_alloc; // Same signature for every test, this one does not realloc
     printf("\n=== Speed Benchmark for %s ===\n", name);
     const int iterations = 10000;
     srand(time(NULL));  // Seed random for sizes
@@ -146,6 +502,7 @@ void benchmark_speed(const char* name, alloc_func alloc, free_func dealloc, real
 
 // Memory usage benchmark
 void benchmark_memory(const char* name, alloc_func alloc, free_func dealloc, realloc_func re_alloc) {
+    (void)re_alloc; // Same signature for every test, this one does not realloc
     printf("\n=== Memory Usage Benchmark for %s ===\n", name);
     const int num_allocs = 10000;
     srand(time(NULL));  // Seed random for sizes
@@ -198,10 +555,13 @@ int main() {
 
     printf("\nRunning tests for custom ft_malloc/ft_free/ft_realloc\n");
     test_functionality("Custom", ft_malloc, ft_free, ft_realloc);
+    test_calloc_zeroing();
+    test_aligned_alloc();
+    test_batch();
+    test_bump_arena();
+    test_invalid_free();
     printf("\n=== Custom Allocation Reports After Functionality Test ===\n");
-    ZoneAllocatorTiny_report();
-    ZoneAllocatorSmall_report();
-    ZoneAllocatorBig_report();
+    ft_malloc_report();
 #ifdef ENABLE_SPEED_BENCHMARK
     benchmark_speed("Custom", ft_malloc, ft_free, ft_realloc);
 #endif
@@ -210,9 +570,7 @@ int main() {
 #endif
 
     printf("\n=== Final Custom Allocation Reports ===\n");
-    ZoneAllocatorTiny_report();
-    ZoneAllocatorSmall_report();
-    ZoneAllocatorBig_report();
+    ft_malloc_report();
 
         printf("Running tests for standard malloc/free/realloc\n");
     test_functionality("Standard", malloc, free, realloc);
@@ -223,5 +581,6 @@ int main() {
     benchmark_memory("Standard", malloc, free, realloc);
 #endif
 
-    return 0;
+    printf("\n%d failed checks\n", failures);
+    return failures != 0;
 }
\ No newline at end of file